@@ -0,0 +1,28 @@
+# Writes <Kernel>.h holding the kernel source as a null terminated char array named <Name>,
+# so the executables carry their kernels instead of reading the .cl files at runtime.
+# Run as a Pre-Build Event: powershell -File EmbedKernel.ps1 -Kernel my_kernels_1.cl -Name my_kernels_1_cl
+param([string]$Kernel, [string]$Name)
+
+$bytes = [IO.File]::ReadAllBytes($Kernel)
+$start = 0
+
+# Skip a UTF-8 BOM, OpenCL compilers expect plain source
+if ($bytes.Length -ge 3 -and $bytes[0] -eq 0xEF -and $bytes[1] -eq 0xBB -and $bytes[2] -eq 0xBF) { $start = 3 }
+
+$sb = New-Object Text.StringBuilder
+[void]$sb.Append("// Generated from $(Split-Path $Kernel -Leaf) by EmbedKernel.ps1, do not edit`n")
+[void]$sb.Append("#pragma once`n`n")
+[void]$sb.Append("static const char $Name[] = {")
+
+for ($i = $start; $i -lt $bytes.Length; $i++) {
+	if ((($i - $start) % 16) -eq 0) { [void]$sb.Append("`n`t") }
+	[void]$sb.Append(('0x{0:x2}, ' -f $bytes[$i]))
+}
+
+[void]$sb.Append("`n`t0x00`n};`n")
+
+# Only rewrite on change so the including .cpp is not rebuilt needlessly
+$out = "$Kernel.h"
+$text = $sb.ToString()
+
+if (!(Test-Path $out) -or ([IO.File]::ReadAllText($out) -ne $text)) { [IO.File]::WriteAllText($out, $text) }
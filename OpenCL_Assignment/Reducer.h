@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+using namespace std;
+
+// Statistics the Reducer can run: the kernel of the first pass over T and of the further passes over the Acc partials
+namespace Op {
+
+	struct Sum {
+		static const char* First() { return "reduce_sum_t"; }
+		static const char* Rest() { return "reduce_sum_t"; }
+		static const bool Centred = false;
+	};
+
+	struct Min {
+		static const char* First() { return "reduce_min_t"; }
+		static const char* Rest() { return "reduce_min_t"; }
+		static const bool Centred = false;
+	};
+
+	struct Max {
+		static const char* First() { return "reduce_max_t"; }
+		static const char* Rest() { return "reduce_max_t"; }
+		static const bool Centred = false;
+	};
+
+	// Sum of squared distances to a centre (the Mean), the partials are then summed
+	struct SquaredDiff {
+		static const char* First() { return "sq_dev_t"; }
+		static const char* Rest() { return "reduce_sum_t"; }
+		static const bool Centred = true;
+	};
+}
+
+/* Multi-level device reduction of T elements into a single Acc with the kernels of my_kernels_reduce.cl:
+
+	program is specialised for (T, Acc) and partials_program for (Acc, Acc) (the same program when T == Acc),
+	both with the same RED_WG_SIZE/RED_ITEMS_PER_THREAD as wg_size/items_per_thread (see SpecialiseOptions).
+	Every pass writes one partial per Workgroup into the Reducer's ping-pong buffers until a single value remains
+*/
+template <typename T, typename Operation, typename Acc = T>
+class Reducer {
+public:
+	cl_ulong kernel_time = 0;		/// Kernel execution time of every pass of the last Run
+	cl::Event first_event;			/// First and last pass of the last Run
+	cl::Event last_event;
+
+	Reducer(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, const cl::Program& partials_program, size_t max_elements, size_t wg_size, size_t items_per_thread)
+		: queue(queue), wg_size(wg_size), group_items(wg_size * items_per_thread)
+	{
+		first = cl::Kernel(program, Operation::First());
+		rest = cl::Kernel(partials_program, Operation::Rest());
+
+		size_t capacity = max((size_t)1, Groups(max_elements));
+
+		for (int i = 0; i < 2; i++)
+			partials[i] = cl::Buffer(context, CL_MEM_READ_WRITE, capacity * sizeof(Acc));
+	}
+
+	// Reduce the first `elements` values of input (centre = Mean for Op::SquaredDiff)
+	Acc Run(const cl::Buffer& input, size_t elements, Acc centre = 0)
+	{
+		kernel_time = 0;
+		int out = 0;
+		bool first_pass = true;
+		size_t nr_group;
+
+		do {
+			nr_group = max((size_t)1, Groups(elements));
+
+			cl::Kernel& kernel = first_pass ? first : rest;
+			cl_uint arg = 0;
+
+			kernel.setArg(arg++, first_pass ? input : partials[1 - out]);
+			kernel.setArg(arg++, partials[out]);
+
+			if (first_pass && Operation::Centred)
+				kernel.setArg(arg++, centre);
+
+			kernel.setArg(arg++, (cl_int)elements);
+
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(nr_group * wg_size), cl::NDRange(wg_size), NULL, &last_event);
+			last_event.wait();
+			kernel_time += last_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - last_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+
+			if (first_pass)
+				first_event = last_event;
+
+			elements = nr_group;
+			out = 1 - out;
+			first_pass = false;
+		} while (nr_group > 1);
+
+		Acc result;
+		queue.enqueueReadBuffer(partials[1 - out], CL_TRUE, 0, sizeof(Acc), &result);
+
+		return result;
+	}
+
+private:
+	cl::CommandQueue queue;
+	cl::Kernel first, rest;
+	cl::Buffer partials[2];
+	size_t wg_size;
+	size_t group_items;		/// Elements covered by one Workgroup
+
+	size_t Groups(size_t elements) const { return (elements + group_items - 1) / group_items; }
+};
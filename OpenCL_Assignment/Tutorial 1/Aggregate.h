@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+using namespace std;
+
+// Per Workgroup partial written by the reduce_moments_float kernel (layout must match the kernel's moments struct)
+struct Moments {
+	cl_int count;
+	cl_float sum;
+	cl_float m2;		/// Sum of squared distances to the Workgroup Mean
+	cl_float min;
+	cl_float max;
+};
+
+// Mergeable running statistics: partials of any split of the data combine into the statistics of the whole
+struct Aggregate {
+	long long count = 0;
+	double sum = 0.0;
+	double m2 = 0.0;		/// Sum of squared distances to the Mean
+	float min = FLT_MAX;
+	float max = -FLT_MAX;
+
+	double Mean() const { return count ? sum / count : 0.0; }
+	double Variance() const { return count ? m2 / count : 0.0; }
+	double StdDev() const { return sqrt(Variance()); }
+
+	// Include one more value (Welford update of m2)
+	void Add(float value)
+	{
+		double delta = value - Mean();
+
+		count++;
+		sum += value;
+		m2 += delta * (value - Mean());
+		min = std::min(min, value);
+		max = std::max(max, value);
+	}
+
+	// Combine with another partial (Chan et al. pairwise update of m2)
+	void Merge(const Aggregate& other)
+	{
+		if (!other.count)
+			return;
+
+		if (!count) {
+			*this = other;
+			return;
+		}
+
+		double delta = other.Mean() - Mean();
+		long long total = count + other.count;
+
+		m2 += other.m2 + delta * delta * ((double)count * other.count / total);
+		sum += other.sum;
+		count = total;
+		min = std::min(min, other.min);
+		max = std::max(max, other.max);
+	}
+
+	void Merge(const Moments& partial)
+	{
+		Aggregate other;
+		other.count = partial.count;
+		other.sum = partial.sum;
+		other.m2 = partial.m2;
+		other.min = partial.min;
+		other.max = partial.max;
+
+		Merge(other);
+	}
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+#include "TemperatureData.h"
+
+using namespace std;
+
+namespace Anomaly {
+
+	// Station x month baselines and the readings that stray too far from them
+	struct Result {
+		vector<cl_float> mean;		/// Per group Mean
+		vector<cl_float> std_dev;	/// Per group Std Deviation
+		vector<cl_int> group;		/// Group of each reading
+		vector<cl_int> indices;		/// Rows of the flagged readings (ascending)
+		size_t count = 0;			/// Total number of flagged readings
+	};
+
+	// Group index of each reading: station * 12 + (month - 1)
+	size_t BuildGroupIndex(const TemperatureData::Records& records, vector<cl_int>& group)
+	{
+		group.resize(records.size());
+
+		for (size_t i = 0; i < records.size(); i++)
+			group[i] = records.station[i] * 12 + (records.date[i] / 100) % 100 - 1;
+
+		return records.stationNames.size() * 12;
+	}
+
+	// Flag readings whose z-score against their station x month baseline exceeds threshold
+	// Returns false when there are no readings to baseline
+	bool Detect(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, const TemperatureData::Records& records, size_t local_size, float threshold, Result& result, cl::Event& profiling_event)
+	{
+		size_t nr_groups = BuildGroupIndex(records, result.group);
+		size_t input_elements = records.size();
+		size_t global_size = ((input_elements + local_size - 1) / local_size) * local_size;
+
+		if (!input_elements)
+			return false;
+
+		/* Group accumulators:
+
+			Each Workgroup keeps a private sum + count per group in local memory and flushes them once.
+			When the groups do not fit (about a thousand stations on 64KB of local memory) every reading
+			adds to the global groups directly, slower under contention but independent of the station count
+		*/
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+		bool local_groups = nr_groups * (sizeof(cl_float) + sizeof(cl_int)) <= device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+
+		/* Output capacity:
+
+			By Chebyshev's inequality at most 1/threshold^2 of each group can lie further than threshold Std Deviations from its mean,
+			so N / threshold^2 slots always hold every anomaly without allocating a full input sized index buffer
+		*/
+		size_t capacity = input_elements;
+
+		if (threshold > 1.0f)
+			capacity = min(input_elements, (size_t)(input_elements / (threshold * threshold)) + 1);
+
+		// Device Buffers
+		cl::Buffer buffer_values(context, CL_MEM_READ_ONLY, input_elements * sizeof(cl_float));
+		cl::Buffer buffer_group(context, CL_MEM_READ_ONLY, input_elements * sizeof(cl_int));
+		cl::Buffer buffer_gsum(context, CL_MEM_READ_WRITE, nr_groups * sizeof(cl_float));
+		cl::Buffer buffer_gcount(context, CL_MEM_READ_WRITE, nr_groups * sizeof(cl_int));
+		cl::Buffer buffer_gsq(context, CL_MEM_READ_WRITE, nr_groups * sizeof(cl_float));
+		cl::Buffer buffer_indices(context, CL_MEM_WRITE_ONLY, capacity * sizeof(cl_int));
+		cl::Buffer buffer_count(context, CL_MEM_READ_WRITE, sizeof(cl_int));
+
+		queue.enqueueWriteBuffer(buffer_values, CL_TRUE, 0, input_elements * sizeof(cl_float), &records.temperature[0]);
+		queue.enqueueWriteBuffer(buffer_group, CL_TRUE, 0, input_elements * sizeof(cl_int), &result.group[0]);
+
+		queue.enqueueFillBuffer(buffer_gsum, (cl_float)0, 0, nr_groups * sizeof(cl_float));
+		queue.enqueueFillBuffer(buffer_gcount, (cl_int)0, 0, nr_groups * sizeof(cl_int));
+		queue.enqueueFillBuffer(buffer_gsq, (cl_float)0, 0, nr_groups * sizeof(cl_float));
+		queue.enqueueFillBuffer(buffer_count, (cl_int)0, 0, sizeof(cl_int));
+
+		// Pass 1: group Sums + Counts
+		cl::Kernel kernel_sum = cl::Kernel(program, local_groups ? "group_sum_float" : "group_sum_global_float");
+		kernel_sum.setArg(0, buffer_values);
+		kernel_sum.setArg(1, buffer_group);
+		kernel_sum.setArg(2, buffer_gsum);
+		kernel_sum.setArg(3, buffer_gcount);
+
+		if (local_groups) {
+			kernel_sum.setArg(4, cl::Local(nr_groups * sizeof(cl_float)));
+			kernel_sum.setArg(5, cl::Local(nr_groups * sizeof(cl_int)));
+			kernel_sum.setArg(6, (cl_int)nr_groups);
+			kernel_sum.setArg(7, (cl_int)input_elements);
+		}
+		else
+			kernel_sum.setArg(4, (cl_int)input_elements);
+
+		queue.enqueueNDRangeKernel(kernel_sum, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size));
+
+		// Pass 2: group squared distances to the Mean
+		cl::Kernel kernel_sq = cl::Kernel(program, local_groups ? "group_sq_dev_float" : "group_sq_dev_global_float");
+		kernel_sq.setArg(0, buffer_values);
+		kernel_sq.setArg(1, buffer_group);
+		kernel_sq.setArg(2, buffer_gsum);
+		kernel_sq.setArg(3, buffer_gcount);
+		kernel_sq.setArg(4, buffer_gsq);
+
+		if (local_groups) {
+			kernel_sq.setArg(5, cl::Local(nr_groups * sizeof(cl_float)));
+			kernel_sq.setArg(6, (cl_int)nr_groups);
+			kernel_sq.setArg(7, (cl_int)input_elements);
+		}
+		else
+			kernel_sq.setArg(5, (cl_int)input_elements);
+
+		queue.enqueueNDRangeKernel(kernel_sq, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size));
+
+		// Pass 3: flag + compact the outliers
+		cl::Kernel kernel_flag = cl::Kernel(program, "flag_anomalies_float");
+		kernel_flag.setArg(0, buffer_values);
+		kernel_flag.setArg(1, buffer_group);
+		kernel_flag.setArg(2, buffer_gsum);
+		kernel_flag.setArg(3, buffer_gcount);
+		kernel_flag.setArg(4, buffer_gsq);
+		kernel_flag.setArg(5, (cl_float)threshold);
+		kernel_flag.setArg(6, buffer_indices);
+		kernel_flag.setArg(7, buffer_count);
+		kernel_flag.setArg(8, (cl_int)capacity);
+		kernel_flag.setArg(9, (cl_int)input_elements);
+
+		queue.enqueueNDRangeKernel(kernel_flag, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size), NULL, &profiling_event);
+
+		// Read back the baselines and the compacted indices
+		vector<cl_float> gsum(nr_groups), gsq(nr_groups);
+		vector<cl_int> gcount(nr_groups);
+		cl_int count = 0;
+
+		queue.enqueueReadBuffer(buffer_gsum, CL_TRUE, 0, nr_groups * sizeof(cl_float), &gsum[0]);
+		queue.enqueueReadBuffer(buffer_gcount, CL_TRUE, 0, nr_groups * sizeof(cl_int), &gcount[0]);
+		queue.enqueueReadBuffer(buffer_gsq, CL_TRUE, 0, nr_groups * sizeof(cl_float), &gsq[0]);
+		queue.enqueueReadBuffer(buffer_count, CL_TRUE, 0, sizeof(cl_int), &count);
+
+		result.mean.assign(nr_groups, 0.0f);
+		result.std_dev.assign(nr_groups, 0.0f);
+
+		for (size_t g = 0; g < nr_groups; g++)
+		{
+			if (gcount[g])
+			{
+				result.mean[g] = gsum[g] / gcount[g];
+				result.std_dev[g] = sqrt(gsq[g] / gcount[g]);
+			}
+		}
+
+		result.count = count;
+		result.indices.resize(min((size_t)count, capacity));
+
+		if (!result.indices.empty())
+			queue.enqueueReadBuffer(buffer_indices, CL_TRUE, 0, result.indices.size() * sizeof(cl_int), &result.indices[0]);
+
+		// Workgroups reserve output slots in completion order
+		sort(result.indices.begin(), result.indices.end());
+
+		return true;
+	}
+}
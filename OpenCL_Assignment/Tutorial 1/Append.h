@@ -0,0 +1,124 @@
+#pragma once
+
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "Aggregate.h"
+
+using namespace std;
+
+/* Incremental ingestion of a growing temperature file:
+
+	A state file records how many bytes of the data file were already consumed and the running (count, sum, M2, min, max)
+	of every station per month. An update only parses the lines appended since, folds them into the running aggregates
+	and saves the state again, so the cost is O(new rows) instead of a rescan of the whole history.
+	A trailing line without its newline is still being written and is left for the next update
+*/
+namespace Append {
+
+	typedef pair<string, int> Key;		/// (Station, yyyymm)
+
+	struct State {
+		long long offset = 0;			/// Bytes of the data file already folded into groups
+		map<Key, Aggregate> groups;
+	};
+
+	// Read a state file (an empty State when it does not exist yet)
+	State Load(const string& stateDir)
+	{
+		State state;
+		ifstream file(stateDir);
+
+		if (!file.is_open())
+			return state;
+
+		string header;
+
+		if (!(file >> header >> state.offset) || header != "offset")
+			return State();
+
+		Key key;
+		Aggregate group;
+
+		while (file >> key.first >> key.second >> group.count >> group.sum >> group.m2 >> group.min >> group.max)
+			state.groups[key] = group;
+
+		return state;
+	}
+
+	// Write the state as text ("offset N" then one "STATION yyyymm count sum m2 min max" line per group)
+	bool Save(const string& stateDir, const State& state)
+	{
+		ofstream file(stateDir);
+
+		if (!file.is_open())
+			return false;
+
+		// Round trip precision, the running sums keep growing across updates
+		file << setprecision(17);
+		file << "offset " << state.offset << "\n";
+
+		for (const auto& group : state.groups)
+			file << group.first.first << " " << group.first.second << " " << group.second.count << " " << group.second.sum << " "
+				<< group.second.m2 << " " << group.second.min << " " << group.second.max << "\n";
+
+		return (bool)file;
+	}
+
+	// Fold the complete lines appended to fileDir since state.offset into the groups, returns the rows added (-1 if the file was not found)
+	long long Update(const string& fileDir, State& state)
+	{
+		// Binary mode so tellg/seekg offsets are byte offsets on every platform
+		ifstream file(fileDir, ios::binary);
+
+		if (!file.is_open())
+			return -1;
+
+		file.seekg(0, ios::end);
+		long long size = (long long)file.tellg();
+
+		// A shorter file was replaced or truncated, the history no longer matches it
+		if (size < state.offset)
+			state = State();
+
+		file.seekg(state.offset);
+
+		string line, name;
+		int year, month, day, hhmm;
+		float temp;
+		long long rows = 0;
+
+		while (getline(file, line))
+		{
+			if (file.eof())
+				break;
+
+			state.offset += line.size() + 1;
+
+			istringstream fields(line);
+
+			if (!(fields >> name >> year >> month >> day >> hhmm >> temp))
+				continue;
+
+			state.groups[Key(name, year * 100 + month)].Add(temp);
+			rows++;
+		}
+
+		return rows;
+	}
+
+	// Statistics of every station over all of its months
+	map<string, Aggregate> Stations(const State& state)
+	{
+		map<string, Aggregate> stations;
+
+		for (const auto& group : state.groups)
+			stations[group.first.first].Merge(group.second);
+
+		return stations;
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+#include "Reduction.h"
+
+using namespace std;
+
+namespace ArgExtreme {
+
+	// Extreme value and the row that recorded it
+	struct Result {
+		cl_float value;
+		cl_int row;
+	};
+
+	/* Min (or Max) of the first `elements` values of buffer_values together with its row:
+
+		Each pass reduces every Workgroup to a single (value, row) pair, passes repeat on the pairs until one Workgroup remains
+		kernel_time = sum of every pass' kernel execution time
+	*/
+	Result Reduce(const cl::CommandQueue& queue, const cl::Program& program, const cl::Buffer& buffer_values, size_t elements, size_t local_size, Reduction::Scratch& scratch, bool largest, cl_ulong& kernel_time)
+	{
+		cl::Kernel kernel = cl::Kernel(program, largest ? "reduce_max_index_float" : "reduce_min_index_float");
+
+		// (value, row) pairs ping-pong through the shared scratch
+		cl::Buffer* buffer_val = scratch.partials;
+		cl::Buffer* buffer_idx = scratch.rows;
+		size_t nr_group;
+
+		kernel.setArg(4, cl::Local(local_size * sizeof(cl_float)));
+		kernel.setArg(5, cl::Local(local_size * sizeof(cl_int)));
+
+		int out = 0;
+		bool first = true;
+		kernel_time = 0;
+
+		do {
+			nr_group = (elements + local_size - 1) / local_size;
+
+			kernel.setArg(0, first ? buffer_values : buffer_val[1 - out]);
+			kernel.setArg(1, buffer_idx[1 - out]);
+			kernel.setArg(2, buffer_val[out]);
+			kernel.setArg(3, buffer_idx[out]);
+			kernel.setArg(6, (cl_int)first);
+			kernel.setArg(7, (cl_int)elements);
+
+			cl::Event profiling_event;
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(nr_group * local_size), cl::NDRange(local_size), NULL, &profiling_event);
+			profiling_event.wait();
+			kernel_time += profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+
+			elements = nr_group;
+			out = 1 - out;
+			first = false;
+		} while (nr_group > 1);
+
+		Result result;
+		queue.enqueueReadBuffer(buffer_val[1 - out], CL_TRUE, 0, sizeof(cl_float), &result.value);
+		queue.enqueueReadBuffer(buffer_idx[1 - out], CL_TRUE, 0, sizeof(cl_int), &result.row);
+
+		return result;
+	}
+}
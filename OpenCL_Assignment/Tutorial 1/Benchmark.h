@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+using namespace std;
+
+/* Repeated kernel timings:
+
+	A variant is any callable returning the kernel time of one complete run in ns, every pass of a multi-pass reduction included.
+	It runs `warmup` untimed times (compilation, allocation and cache effects) and then `runs` timed times,
+	reported as min / median / p95 with the effective bandwidth and element rate of the median
+*/
+namespace Benchmark {
+
+	struct Stats {
+		cl_ulong min = 0;
+		cl_ulong median = 0;
+		cl_ulong p95 = 0;
+	};
+
+	Stats Summarise(vector<cl_ulong> times)
+	{
+		Stats stats;
+
+		if (times.empty())
+			return stats;
+
+		sort(times.begin(), times.end());
+
+		// Nearest rank percentiles
+		stats.min = times.front();
+		stats.median = times[(times.size() - 1) / 2];
+		stats.p95 = times[(times.size() * 95 + 99) / 100 - 1];
+
+		return stats;
+	}
+
+	template <typename Run>
+	Stats Repeat(size_t warmup, size_t runs, Run run)
+	{
+		for (size_t i = 0; i < warmup; i++)
+			run();
+
+		vector<cl_ulong> times;
+
+		for (size_t i = 0; i < runs; i++)
+			times.push_back(run());
+
+		return Summarise(times);
+	}
+
+	void PrintHeader()
+	{
+		std::cout << left << setw(24) << "Variant" << right << setw(12) << "Min [ns]" << setw(12) << "Median [ns]" << setw(12) << "p95 [ns]"
+			<< setw(10) << "GB/s" << setw(14) << "Melements/s" << endl;
+	}
+
+	// One row: bytes and elements are what a single run reads (the input of its first pass)
+	void Print(const string& name, const Stats& stats, size_t bytes, size_t elements)
+	{
+		double seconds = stats.median * 1e-9;
+
+		std::cout << left << setw(24) << name << right << setw(12) << stats.min << setw(12) << stats.median << setw(12) << stats.p95 << fixed << setprecision(2)
+			<< setw(10) << (seconds > 0 ? bytes / seconds * 1e-9 : 0.0) << setw(14) << (seconds > 0 ? elements / seconds * 1e-6 : 0.0) << defaultfloat << endl;
+	}
+}
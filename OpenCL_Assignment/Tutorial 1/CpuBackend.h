@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+#include "Aggregate.h"
+#include "Simd.h"
+
+using namespace std;
+
+/* Native multithreaded statistics:
+
+	Same Sum/Min/Max/Std Deviation/Histogram results as the kernels, for hosts without an OpenCL ICD
+	and as a correctness reference. Each thread reduces one contiguous slice, the slices are merged like Workgroup partials
+*/
+namespace CpuBackend {
+
+	// True when the requested platform/device does not exist (no ICD installed, or bad -p/-d)
+	bool Required(int platform_id, int device_id)
+	{
+		try {
+			vector<cl::Platform> platforms;
+			cl::Platform::get(&platforms);
+
+			if (platform_id < 0 || platform_id >= (int)platforms.size())
+				return true;
+
+			vector<cl::Device> devices;
+			platforms[platform_id].getDevices((cl_device_type)CL_DEVICE_TYPE_ALL, &devices);
+
+			return device_id < 0 || device_id >= (int)devices.size();
+		}
+		catch (const cl::Error&) {
+			return true;
+		}
+	}
+
+	size_t DefaultThreads()
+	{
+		return max(1u, thread::hardware_concurrency());
+	}
+
+	// Statistics of one slice: Sum/Min/Max in a first sweep, squared distances to the slice Mean in a second
+	Aggregate SliceStatistics(const float* values, size_t count, Simd::Level level)
+	{
+		Aggregate result;
+
+		if (!count)
+			return result;
+
+		Simd::SumMinMax(values, count, level, result.sum, result.min, result.max);
+
+		result.count = count;
+		result.m2 = Simd::SquaredDiff(values, count, (float)(result.sum / count), level);
+
+		return result;
+	}
+
+	// Statistics of one int16 slice in tenths of a degree, returned in degrees
+	Aggregate SliceStatistics(const short* tenths, size_t count, Simd::Level level)
+	{
+		Aggregate result;
+
+		if (!count)
+			return result;
+
+		long long sum = 0;
+		short min_value = SHRT_MAX, max_value = SHRT_MIN;
+		Simd::SumMinMax(tenths, count, level, sum, min_value, max_value);
+
+		// Exact integer distances to the rounded Mean, corrected to the true Mean
+		double mean = (double)sum / count;
+		short centre = (short)llround(mean);
+		long long sq = Simd::SquaredDiff(tenths, count, centre, min_value, max_value, level);
+
+		result.count = count;
+		result.sum = sum / 10.0;
+		result.m2 = (sq - count * (mean - centre) * (mean - centre)) / 100.0;
+		result.min = min_value / 10.0f;
+		result.max = max_value / 10.0f;
+
+		return result;
+	}
+
+	// Run fn(first, count, slice_index) on `threads` contiguous slices of [0, size)
+	template <typename Fn>
+	void ParallelSlices(size_t size, size_t threads, Fn fn)
+	{
+		threads = max((size_t)1, min(threads, size));
+		vector<thread> workers;
+		size_t slice = (size + threads - 1) / threads;
+
+		for (size_t t = 0; t < threads; t++) {
+			size_t first = t * slice;
+			size_t count = first < size ? min(slice, size - first) : 0;
+			workers.push_back(thread(fn, first, count, t));
+		}
+
+		for (thread& worker : workers)
+			worker.join();
+	}
+
+	// Count, Sum, Mean, Min, Max and Std Deviation of values (float degrees or int16 tenths)
+	template <typename T>
+	Aggregate Statistics(const vector<T>& values, size_t threads, Simd::Level level = Simd::Best())
+	{
+		threads = max((size_t)1, min(threads, values.size()));
+		vector<Aggregate> partials(threads);
+
+		ParallelSlices(values.size(), threads, [&](size_t first, size_t count, size_t t) {
+			partials[t] = SliceStatistics(values.data() + first, count, level);
+		});
+
+		Aggregate result;
+
+		for (const Aggregate& partial : partials)
+			result.Merge(partial);
+
+		return result;
+	}
+
+	// Equal width histogram of values (float degrees or int16 tenths) over [lo, hi] degrees (hi falls in the last bin)
+	template <typename T>
+	vector<cl_uint> Histogram(const vector<T>& values, float lo, float hi, size_t bins, size_t threads, Simd::Level level = Simd::Best())
+	{
+		threads = max((size_t)1, min(threads, values.size()));
+		vector<vector<cl_uint> > partials(threads, vector<cl_uint>(bins, 0));
+
+		// The bins are computed in the units of the values
+		float units = is_same<T, short>::value ? 10.0f : 1.0f;
+		float scale = hi > lo ? bins / ((hi - lo) * units) : 0.0f;
+
+		// Private bins per thread, merged afterwards
+		ParallelSlices(values.size(), threads, [&](size_t first, size_t count, size_t t) {
+			Simd::Histogram(values.data() + first, count, lo * units, scale, (int)bins, partials[t].data(), level);
+		});
+
+		vector<cl_uint> result(bins, 0);
+
+		for (const vector<cl_uint>& partial : partials)
+			for (size_t b = 0; b < bins; b++)
+				result[b] += partial[b];
+
+		return result;
+	}
+
+	// True when two results over the same values agree: Count, Min and Max exactly, Sum and M2 up to float rounding (lane orders differ)
+	bool Agree(const Aggregate& a, const Aggregate& b)
+	{
+		auto close = [&](double x, double y) { return fabs(x - y) <= 1e-4 * max(fabs(x), fabs(y)) + 1e-6 * a.count; };
+
+		return a.count == b.count && a.min == b.min && a.max == b.max && close(a.sum, b.sum) && close(a.m2, b.m2);
+	}
+}
@@ -4,6 +4,7 @@
 #define __CL_ENABLE_EXCEPTIONS
 
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #ifdef __APPLE__
@@ -15,6 +16,25 @@
 #include <stdlib.h>
 
 #include "Utils.h"
+#include "my_kernels_1.cl.h"
+#include "../my_kernels_reduce.cl.h"
+#include "TemperatureData.h"
+#include "Rollup.h"
+#include "Anomaly.h"
+#include "TopK.h"
+#include "ArgExtreme.h"
+#include "Reduction.h"
+#include "../Reducer.h"
+#include "Streaming.h"
+#include "ZeroCopy.h"
+#include "CpuBackend.h"
+#include "MultiDevice.h"
+#include "Histogram.h"
+#include "Service.h"
+#include "Append.h"
+#include "Summary.h"
+#include "StationSort.h"
+#include "Benchmark.h"
 
 
 // Launch Arguments (e.g. "Tutorial1 - p")
@@ -24,6 +44,37 @@ void print_help() {
 	std::cerr << "  -p : select platform " << std::endl;
 	std::cerr << "  -d : select device" << std::endl;
 	std::cerr << "  -l : list all platforms and devices" << std::endl;
+	std::cerr << "  -f : temperature file to analyse" << std::endl;
+	std::cerr << "  -daily : roll readings up into a daily min/max/mean series" << std::endl;
+	std::cerr << "  -daily_out : write the daily series to a binary file (implies -daily)" << std::endl;
+	std::cerr << "  -anomaly : flag readings whose station x month z-score exceeds the given threshold" << std::endl;
+	std::cerr << "  -topk : report the given number of hottest and coldest readings" << std::endl;
+	std::cerr << "  -stream : process the file in chunks of the given number of rows (bounded device memory)" << std::endl;
+	std::cerr << "  -pipeline : overlap parsing, uploads and kernels of the streamed chunks over the given number of buffers" << std::endl;
+	std::cerr << "  -zerocopy : share host mapped buffers with the device instead of copying (CPU devices)" << std::endl;
+	std::cerr << "  -hist : print a histogram of the temperatures with the given number of bins" << std::endl;
+	std::cerr << "  -append : fold only the lines added since the last run into the per station/month state kept in the given file" << std::endl;
+	std::cerr << "  -blob_out : save the mergeable statistics (and -hist histogram over a fixed range) to a binary file" << std::endl;
+	std::cerr << "  -merge : merge a comma separated list of -blob_out files and print the combined statistics" << std::endl;
+	std::cerr << "  -cpu : use the native multithreaded backend (automatic when no OpenCL device is found)" << std::endl;
+	std::cerr << "  -threads : number of threads of the native backend" << std::endl;
+	std::cerr << "  -int16 : run the native backend on an int16 tenths-of-a-degree copy of the temperatures" << std::endl;
+	std::cerr << "  -scalar : disable the AVX2/AVX-512 loops of the native backend" << std::endl;
+	std::cerr << "  -verify : check the native backend's SIMD statistics and histogram against its scalar loops" << std::endl;
+	std::cerr << "  -multi : split the statistics across \"all\" devices or a \"platform:device,...\" list" << std::endl;
+	std::cerr << "  -numa : split CPU devices into one sub-device per NUMA node, each reducing a node local slice" << std::endl;
+	std::cerr << "  -serve : keep the dataset on the device and answer queries read from stdin (see Service.h)" << std::endl;
+	std::cerr << "  -result_cache : number of -serve results kept in memory (0 = none)" << std::endl;
+	std::cerr << "  -result_dir : directory keeping -serve results across runs (created if missing)" << std::endl;
+	std::cerr << "  -zone_rows : rows per -serve zone map block (0 = scan every row per query)" << std::endl;
+	std::cerr << "  -range_index : answer -serve queries from per station prefix sums and Min/Max sparse tables built on the device" << std::endl;
+	std::cerr << "  -sort : reorder the readings by station and time on the device (order kept in the program cache)" << std::endl;
+	std::cerr << "  -bench : time every kernel variant over the given number of runs (min/median/p95, GB/s) instead of the normal report" << std::endl;
+	std::cerr << "  -warmup : untimed runs before each -bench variant" << std::endl;
+	std::cerr << "  -wg : Workgroup size (power of two) the kernels are compiled for (on every -multi device too)" << std::endl;
+	std::cerr << "  -items : number of elements each work-item reduces before the Workgroup tree" << std::endl;
+	std::cerr << "  -cache : directory of the cached program binaries (default: the per-user cache directory, created if missing)" << std::endl;
+	std::cerr << "  -nocache : always compile the kernels instead of loading cached program binaries" << std::endl;
 	std::cerr << "  -h : print this message" << std::endl;
 }
 
@@ -34,15 +85,376 @@ int main(int argc, char **argv)
 	int platform_id = 0;
 	int device_id = 0;
 
+	// Directory of Temperature Files
+	/// Relative Pathing
+	//string fileDir = "..\\..\\temp_lincolnshire.txt";
+	//string fileDir = "..\\..\\temp_lincolnshire_short.txt";
+	/// Aboslute Pathing
+	string fileDir = "C:\\Users\\Student\\Desktop\\OpenCL-Assignment\\OpenCL_Assignment\\temp_lincolnshire.txt";
+	//string fileDir = "C:\\Users\\Student\\Desktop\\OpenCL-Assignment\\OpenCL_Assignment\\temp_lincolnshire_short.txt";
+
+	bool daily = false;
+	string dailyDir;
+	float anomalyThreshold = 0.0f;	/// 0 = anomaly detection disabled
+	int topK = 0;					/// 0 = no Top-K report
+	size_t streamRows = 0;			/// 0 = load the whole file
+	size_t pipelineSlots = 0;		/// 0 = blocking streaming
+	bool zeroCopy = false;
+	size_t histBins = 0;			/// 0 = no histogram
+	string appendState;				/// Empty = no incremental state
+	string blobOut;					/// Empty = no mergeable summary file
+	string mergeBlobs;				/// Empty = no merge
+	bool cpuBackend = false;
+	size_t cpuThreads = CpuBackend::DefaultThreads();
+	Simd::Level simdLevel = Simd::Best();
+	bool int16 = false;
+	bool verify = false;
+	string multiDevices;			/// Empty = single device
+	bool numa = false;
+	bool serve = false;
+	size_t resultCacheSize = 1024;	/// In-memory -serve results (0 = no memory cache)
+	string resultDir;				/// Empty = no on-disk result cache
+	size_t zoneRows = 65536;		/// Rows per zone map block (0 = no zone map)
+	bool rangeIndex = false;
+	bool sortRows = false;
+	size_t benchRuns = 0;			/// 0 = no benchmark
+	size_t benchWarmup = 3;
+	string programCache = DefaultCacheDir();		/// Directory of cached program binaries and sort orders (empty = always compile)
+	size_t workgroupSize = 64;		/// Power of two, compiled into the specialised reductions
+	size_t itemsPerThread = 4;		/// Elements accumulated by each work-item before the Workgroup tree
+
 	for (int i = 1; i < argc; i++)	{
 		if ((strcmp(argv[i], "-p") == 0) && (i < (argc - 1))) { platform_id = atoi(argv[++i]); }
 		else if ((strcmp(argv[i], "-d") == 0) && (i < (argc - 1))) { device_id = atoi(argv[++i]); }
 		else if (strcmp(argv[i], "-l") == 0) { std::cout << ListPlatformsDevices() << std::endl; }
+		else if ((strcmp(argv[i], "-f") == 0) && (i < (argc - 1))) { fileDir = argv[++i]; }
+		else if (strcmp(argv[i], "-daily") == 0) { daily = true; }
+		else if ((strcmp(argv[i], "-daily_out") == 0) && (i < (argc - 1))) { daily = true; dailyDir = argv[++i]; }
+		else if ((strcmp(argv[i], "-anomaly") == 0) && (i < (argc - 1))) { anomalyThreshold = (float)atof(argv[++i]); }
+		else if ((strcmp(argv[i], "-topk") == 0) && (i < (argc - 1))) { topK = atoi(argv[++i]); }
+		else if ((strcmp(argv[i], "-stream") == 0) && (i < (argc - 1))) { streamRows = strtoul(argv[++i], 0, 10); }
+		else if ((strcmp(argv[i], "-pipeline") == 0) && (i < (argc - 1))) { pipelineSlots = strtoul(argv[++i], 0, 10); }
+		else if (strcmp(argv[i], "-zerocopy") == 0) { zeroCopy = true; }
+		else if ((strcmp(argv[i], "-hist") == 0) && (i < (argc - 1))) { histBins = strtoul(argv[++i], 0, 10); }
+		else if ((strcmp(argv[i], "-append") == 0) && (i < (argc - 1))) { appendState = argv[++i]; }
+		else if ((strcmp(argv[i], "-blob_out") == 0) && (i < (argc - 1))) { blobOut = argv[++i]; }
+		else if ((strcmp(argv[i], "-merge") == 0) && (i < (argc - 1))) { mergeBlobs = argv[++i]; }
+		else if (strcmp(argv[i], "-cpu") == 0) { cpuBackend = true; }
+		else if ((strcmp(argv[i], "-threads") == 0) && (i < (argc - 1))) { cpuThreads = strtoul(argv[++i], 0, 10); }
+		else if (strcmp(argv[i], "-int16") == 0) { int16 = true; }
+		else if (strcmp(argv[i], "-scalar") == 0) { simdLevel = Simd::SCALAR; }
+		else if (strcmp(argv[i], "-verify") == 0) { verify = true; }
+		else if ((strcmp(argv[i], "-multi") == 0) && (i < (argc - 1))) { multiDevices = argv[++i]; }
+		else if (strcmp(argv[i], "-numa") == 0) { numa = true; }
+		else if (strcmp(argv[i], "-serve") == 0) { serve = true; }
+		else if ((strcmp(argv[i], "-result_cache") == 0) && (i < (argc - 1))) { resultCacheSize = strtoul(argv[++i], 0, 10); }
+		else if ((strcmp(argv[i], "-result_dir") == 0) && (i < (argc - 1))) { resultDir = argv[++i]; }
+		else if (strcmp(argv[i], "-range_index") == 0) { rangeIndex = true; }
+		else if (strcmp(argv[i], "-sort") == 0) { sortRows = true; }
+		else if ((strcmp(argv[i], "-bench") == 0) && (i < (argc - 1))) { benchRuns = strtoul(argv[++i], 0, 10); }
+		else if ((strcmp(argv[i], "-warmup") == 0) && (i < (argc - 1))) { benchWarmup = strtoul(argv[++i], 0, 10); }
+		else if ((strcmp(argv[i], "-zone_rows") == 0) && (i < (argc - 1))) { zoneRows = strtoul(argv[++i], 0, 10); }
+		else if (strcmp(argv[i], "-nocache") == 0) { programCache = ""; }
+		else if ((strcmp(argv[i], "-cache") == 0) && (i < (argc - 1))) { programCache = argv[++i]; }
+		else if ((strcmp(argv[i], "-wg") == 0) && (i < (argc - 1))) { workgroupSize = strtoul(argv[++i], 0, 10); }
+		else if ((strcmp(argv[i], "-items") == 0) && (i < (argc - 1))) { itemsPerThread = strtoul(argv[++i], 0, 10); }
 		else if (strcmp(argv[i], "-h") == 0) { print_help(); return 0;}
 	}
 
+	// A cache directory that cannot be created only costs the compilation
+	if (!programCache.empty() && !MakeDirectories(programCache)) {
+		std::cerr << "Cache directory " << programCache << " could not be created, compiling from source" << std::endl;
+		programCache = "";
+	}
+
+	if (!resultDir.empty() && !MakeDirectories(resultDir)) {
+		std::cerr << "Result directory " << resultDir << " could not be created, -serve results are kept in memory only" << std::endl;
+		resultDir = "";
+	}
+
 	try {
 
+		// ============== Merge Summaries ==============
+		/// Combines the -blob_out files of the shards of a dataset into the statistics of the whole
+
+		if (!mergeBlobs.empty())
+		{
+			Summary::Blob merged;
+			size_t start = 0, shards = 0;
+
+			while (start < mergeBlobs.size())
+			{
+				size_t end = mergeBlobs.find(',', start);
+
+				if (end == string::npos)
+					end = mergeBlobs.size();
+
+				string blobDir = mergeBlobs.substr(start, end - start);
+				Summary::Blob blob;
+
+				if (!Summary::Load(blobDir, blob))
+					cout << "\nSummary " << blobDir << " could not be read!" << endl;
+				else {
+					if (!Summary::Merge(merged, blob))
+						cout << "\nSummary " << blobDir << " has different histogram bins, the merged histogram was dropped!" << endl;
+
+					shards++;
+				}
+
+				start = end + 1;
+			}
+
+			std::cout << "\nProgram Execution Completed!\n" << endl;
+
+			std::cout << "********************* FLOAT Results (" << shards << " shards) *********************" << endl;
+			std::cout << "Count		= " << merged.aggregate.count << endl;
+			std::cout << "Sum		= " << merged.aggregate.sum << endl;
+			std::cout << "Average		= " << merged.aggregate.Mean() << endl;
+			std::cout << "Min		= " << merged.aggregate.min << endl;
+			std::cout << "Max		= " << merged.aggregate.max << endl;
+			std::cout << "Std Deviation   = " << merged.aggregate.StdDev() << endl << endl;
+
+			if (!merged.histogram.empty())
+			{
+				std::cout << "********************* Histogram *********************" << endl;
+				Histogram::Print(merged.histogram, merged.lo, merged.hi);
+				std::cout << endl;
+			}
+
+			if (!blobOut.empty() && !Summary::Save(blobOut, merged))
+				cout << "Summary could not be written to " << blobOut << endl;
+
+			system("pause");
+			return 0;
+		}
+
+
+
+		// ============== Incremental Append Mode ==============
+		/// Only the rows appended since the previous run are parsed, the running per station/month aggregates are kept in appendState
+
+		if (!appendState.empty())
+		{
+			Append::State state = Append::Load(appendState);
+			long long added = Append::Update(fileDir, state);
+
+			if (added < 0)
+				cout << "\nTemperature file was not found!" << endl;
+			else if (!Append::Save(appendState, state))
+				cout << "\nAppend state could not be written to " << appendState << endl;
+
+			std::cout << "\nProgram Execution Completed!\n" << endl;
+			std::cout << "Rows Appended: " << max(added, 0LL) << " (" << state.groups.size() << " station months, " << state.offset << " bytes consumed)" << endl << endl;
+
+			Aggregate append_result;
+
+			std::cout << "********************* Stations *********************" << endl;
+
+			for (const auto& station : Append::Stations(state))
+			{
+				std::cout << station.first << ":	" << station.second.count << " readings, mean " << station.second.Mean() << ", min " << station.second.min
+					<< ", max " << station.second.max << ", std " << station.second.StdDev() << endl;
+
+				append_result.Merge(station.second);
+			}
+
+			std::cout << endl;
+
+			std::cout << "********************* FLOAT Results (Incremental) *********************" << endl;
+			std::cout << "Count		= " << append_result.count << endl;
+			std::cout << "Sum		= " << append_result.sum << endl;
+			std::cout << "Average		= " << append_result.Mean() << endl;
+			std::cout << "Min		= " << append_result.min << endl;
+			std::cout << "Max		= " << append_result.max << endl;
+			std::cout << "Std Deviation   = " << append_result.StdDev() << endl << endl;
+
+			system("pause");
+			return 0;
+		}
+
+
+
+		// ============== Native CPU Backend ==============
+		/// Multithreaded host statistics, on request or when no OpenCL device is available
+
+		if (cpuBackend || CpuBackend::Required(platform_id, device_id))
+		{
+			if (!cpuBackend)
+				std::cout << "No OpenCL device found, falling back to the native CPU backend" << endl;
+
+			std::cout << "Running on " << cpuThreads << " CPU thread(s) (" << Simd::Name(simdLevel) << ")" << endl;
+
+			TemperatureData::Records records;
+
+			if (!TemperatureData::LoadText(fileDir, records))
+				cout << "\nTemperature file was not found!" << endl;
+
+			// The int16 column moves half the bytes of the float one
+			std::vector<short> tenths = int16 ? TemperatureData::Tenths(records.temperature) : std::vector<short>();
+
+			Aggregate cpu_result = int16 ? CpuBackend::Statistics(tenths, cpuThreads, simdLevel)
+				: CpuBackend::Statistics(records.temperature, cpuThreads, simdLevel);
+
+			std::cout << "\nProgram Execution Completed!\n" << endl;
+
+			std::cout << "********************* FLOAT Results (CPU) *********************" << endl;
+			std::cout << "Sum		= " << cpu_result.sum << endl;
+			std::cout << "Average		= " << cpu_result.Mean() << endl;
+			std::cout << "Min		= " << cpu_result.min << endl;
+			std::cout << "Max		= " << cpu_result.max << endl;
+			std::cout << "Std Deviation   = " << cpu_result.StdDev() << endl << endl;
+
+			std::vector<cl_uint> cpu_histogram;
+
+			if (histBins)
+			{
+				cpu_histogram = int16 ? CpuBackend::Histogram(tenths, cpu_result.min, cpu_result.max, histBins, cpuThreads, simdLevel)
+					: CpuBackend::Histogram(records.temperature, cpu_result.min, cpu_result.max, histBins, cpuThreads, simdLevel);
+
+				std::cout << "********************* Histogram *********************" << endl;
+				Histogram::Print(cpu_histogram, cpu_result.min, cpu_result.max);
+				std::cout << endl;
+			}
+
+			// Same slices through the scalar loops
+			if (verify)
+			{
+				Aggregate scalar_result = int16 ? CpuBackend::Statistics(tenths, cpuThreads, Simd::SCALAR)
+					: CpuBackend::Statistics(records.temperature, cpuThreads, Simd::SCALAR);
+
+				std::cout << "********************* Verify (" << Simd::Name(simdLevel) << " vs Scalar) *********************" << endl;
+				std::cout << "Statistics:	" << (CpuBackend::Agree(cpu_result, scalar_result) ? "match" : "MISMATCH") << endl;
+
+				if (histBins)
+				{
+					std::vector<cl_uint> scalar_histogram = int16 ? CpuBackend::Histogram(tenths, cpu_result.min, cpu_result.max, histBins, cpuThreads, Simd::SCALAR)
+						: CpuBackend::Histogram(records.temperature, cpu_result.min, cpu_result.max, histBins, cpuThreads, Simd::SCALAR);
+
+					std::cout << "Histogram:	" << (cpu_histogram == scalar_histogram ? "match" : "MISMATCH") << endl;
+				}
+
+				std::cout << endl;
+			}
+
+			if (!blobOut.empty())
+			{
+				Summary::Blob blob;
+				blob.aggregate = cpu_result;
+
+				if (histBins)
+					blob.histogram = int16 ? CpuBackend::Histogram(tenths, Summary::HIST_LO, Summary::HIST_HI, histBins, cpuThreads, simdLevel)
+						: CpuBackend::Histogram(records.temperature, Summary::HIST_LO, Summary::HIST_HI, histBins, cpuThreads, simdLevel);
+
+				if (!Summary::Save(blobOut, blob))
+					cout << "Summary could not be written to " << blobOut << endl;
+			}
+
+			system("pause");
+			return 0;
+		}
+
+
+
+		// ============== Multi-Device Mode ==============
+		/// Every selected device reduces a throughput proportional slice concurrently, the slices are merged on the host
+		/// -numa alone runs the -p/-d device as one sub-device per NUMA node
+
+		if (!multiDevices.empty() || numa)
+		{
+			cl::Program::Sources multi_sources;
+			AddEmbeddedSource(multi_sources, my_kernels_1_cl);
+			AddEmbeddedSource(multi_sources, my_kernels_reduce_cl);
+
+			vector<MultiDevice::Worker> workers;
+			string selection = multiDevices.empty() ? to_string(platform_id) + ":" + to_string(device_id) : multiDevices;
+
+			for (const cl::Device& device : MultiDevice::Devices(selection))
+			{
+				vector<cl::Device> sub_devices = numa ? MultiDevice::NumaSubDevices(device) : vector<cl::Device>{ device };
+
+				for (const cl::Device& sub_device : sub_devices)
+				{
+					// Every device runs the -wg Workgroups, reject it before building for a device that cannot
+					string workgroupError = CheckWorkgroupSize(sub_device, workgroupSize);
+
+					if (!workgroupError.empty() || !itemsPerThread)
+					{
+						std::cerr << "ERROR: " << (workgroupError.empty() ? "-items must be at least 1" : workgroupError) << std::endl;
+
+						system("pause");
+						return 1;
+					}
+
+					workers.push_back(MultiDevice::CreateWorker(sub_device, multi_sources, SpecialiseOptions<cl_float, cl_float>(workgroupSize, itemsPerThread), programCache));
+					workers.back().numa_local = sub_devices.size() > 1;
+				}
+			}
+
+			if (workers.empty())
+			{
+				cout << "\nNo OpenCL device matches -multi " << selection << "!" << endl;
+
+				system("pause");
+				return 0;
+			}
+
+			TemperatureData::Records records;
+
+			if (!TemperatureData::LoadText(fileDir, records))
+			{
+				cout << "\nTemperature file was not found!" << endl;
+
+				system("pause");
+				return 0;
+			}
+
+			MultiDevice::Calibrate(workers, records.temperature, MultiDevice::SampleRows(records.size()), workgroupSize);
+
+			// Every slice bins into the fixed range of the blob so the slices sum into one histogram
+			if (histBins && !blobOut.empty())
+				for (MultiDevice::Worker& worker : workers) {
+					worker.hist_bins = histBins;
+					worker.hist_lo = Summary::HIST_LO;
+					worker.hist_hi = Summary::HIST_HI;
+				}
+
+			Aggregate multi_result = MultiDevice::Run(workers, records.temperature, workgroupSize);
+
+			std::cout << "\nProgram Execution Completed!\n" << endl;
+
+			std::cout << "********************* FLOAT Results (" << workers.size() << " devices) *********************" << endl;
+			std::cout << "Sum		= " << multi_result.sum << endl;
+			std::cout << "Average		= " << multi_result.Mean() << endl;
+			std::cout << "Min		= " << multi_result.min << endl;
+			std::cout << "Max		= " << multi_result.max << endl;
+			std::cout << "Std Deviation   = " << multi_result.StdDev() << endl << endl;
+
+			std::cout << "********************* Profiling *********************" << endl;
+
+			for (const MultiDevice::Worker& worker : workers)
+				std::cout << worker.device.getInfo<CL_DEVICE_NAME>() << ":	" << worker.rows << " rows, " << worker.kernel_time << " [ns]" << endl;
+
+			std::cout << endl;
+
+			Summary::Blob blob;
+			blob.aggregate = multi_result;
+
+			if (histBins && !blobOut.empty())
+			{
+				blob.histogram.assign(histBins, 0);
+
+				for (const MultiDevice::Worker& worker : workers)
+					for (size_t b = 0; b < worker.histogram.size(); b++)
+						blob.histogram[b] += worker.histogram[b];
+			}
+
+			if (!blobOut.empty() && !Summary::Save(blobOut, blob))
+				cout << "Summary could not be written to " << blobOut << endl;
+
+			system("pause");
+			return 0;
+		}
+
 
 		// OpenCL Init procedure
 #pragma region Setup
@@ -55,75 +467,162 @@ int main(int argc, char **argv)
 		// Display the selected device
 		std::cout << "Running on " << GetPlatformName(platform_id) << ", " << GetDeviceName(platform_id, device_id) << std::endl;
 
+		// The reductions are compiled for workgroupSize, reject sizes they cannot run with
+		string workgroupError = CheckWorkgroupSize(context, workgroupSize);
+
+		if (!workgroupError.empty() || !itemsPerThread)
+		{
+			std::cerr << "ERROR: " << (workgroupError.empty() ? "-items must be at least 1" : workgroupError) << std::endl;
+
+			system("pause");
+			return 1;
+		}
+
 		// Create a queue to which we will push commands for the device
 		cl::CommandQueue queue(context, CL_QUEUE_PROFILING_ENABLE);
 
 		// 2.2 Load & build the device code
 		cl::Program::Sources sources;
 
-		// Load kernel to sources
-		AddSources(sources, "my_kernels_1.cl");
+		// Load the kernel sources compiled into the executable (no runtime file I/O)
+		AddEmbeddedSource(sources, my_kernels_1_cl);
+		AddEmbeddedSource(sources, my_kernels_reduce_cl);
 
-		// Create program from Context + Sources
-		cl::Program program(context, sources);
-
-		// Build + Debug the Kernel code
-		try {
-			program.build();
-		}
-		catch (const cl::Error& err) {
-			std::cout << "Build Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
-			std::cout << "Build Options:\t" << program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
-			std::cout << "Build Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
-			throw err;
-		}
+		// Create + Build (or load the cached binary of) the program from Context + Sources
+		/// The shared reductions are specialised for float input and accumulators
+		cl::Program program = BuildProgram(context, sources, SpecialiseOptions<cl_float, cl_float>(workgroupSize, itemsPerThread), programCache);
 
 #pragma endregion
 
-		/// Custom Type Def
-		typedef float myType;
+		if (zeroCopy && !ZeroCopy::Unified(context))
+			std::cout << "Device does not share host memory, mapped buffers will still be transferred" << std::endl;
+
 
 
-		// ==============  Read temperature file into String Vector  ==============
+		// ============== Service Mode ==============
+		/// OpenCL is initialised and the columns uploaded once, then every stdin line is a query answered on stdout
 
-		// Vectors for Raw and Numbered Temperatures
-		std::vector<string> temperatureInfo;	/// Holds file text
-		std::vector<myType> temperatureValues;	/// Holds all Temperature Floats
+		if (serve)
+		{
+			TemperatureData::Records records;
 
-		// File reading variables
-		ifstream file;
-		string fileDir, word;
+			if (!TemperatureData::LoadText(fileDir, records))
+				cout << "\nTemperature file was not found!" << endl;
 
-		// Directory of Temperature Files
-		/// Relative Pathing
-		//fileDir = "..\\..\\temp_lincolnshire.txt";
-		//fileDir = "..\\..\\temp_lincolnshire_short.txt";
-		/// Aboslute Pathing
-		fileDir = "C:\\Users\\Student\\Desktop\\OpenCL-Assignment\\OpenCL_Assignment\\temp_lincolnshire.txt";
-		//fileDir = "C:\\Users\\Student\\Desktop\\OpenCL-Assignment\\OpenCL_Assignment\\temp_lincolnshire_short.txt";
+			// Contiguous stations and dates leave fewer boundary blocks in the zone maps
+			if (sortRows)
+			{
+				cl_ulong sort_time;
+				bool cached = StationSort::Sort(context, queue, program, records, workgroupSize, programCache, sort_time);
 
-		file.open(fileDir);
+				std::cout << "Sorted by station and time " << (cached ? "(cached order)" : "(" + to_string(sort_time) + " [ns])") << endl;
+			}
 
-		if (!file.is_open())
-			cout << "\nTemperature file was not found!" << endl;
+			Service::Resident resident = Service::Upload(context, queue, program, records, workgroupSize, zoneRows);
 
-		// Read fileDir for raw input
-		while (file >> word)
-		{
-			temperatureInfo.push_back(word);
+			if (rangeIndex)
+			{
+				// Leaves of the sparse tables are one Min/Max partial per BLOCK rows
+				cl::Program::Sources leaf_sources;
+				AddEmbeddedSource(leaf_sources, my_kernels_reduce_cl);
+				cl::Program leaf_program = BuildProgram(context, leaf_sources, SpecialiseOptions<cl_float, cl_float>(RangeIndex::BLOCK, 1), programCache);
+
+				cl_ulong index_time;
+				resident.index = RangeIndex::Build(context, queue, program, leaf_program, records, index_time);
+				resident.indexed = true;
+
+				std::cout << "Range index: " << resident.index.levels << " sparse table levels over " << resident.index.blocks << " blocks (" << index_time << " [ns])" << endl;
+			}
+
+			std::cout << "Serving " << records.size() << " readings of " << records.stationNames.size() << " stations, one query per line (\"quit\" to stop)" << endl;
+
+			// Repeated filters are answered from the cache before any kernel launch
+			ResultCache::Lru cache(ResultCache::Fingerprint(records), resultCacheSize, resultDir);
+
+			size_t answered = Service::Run(resident, records, std::cin, std::cout, &cache);
+
+			std::cout << answered << " queries answered (" << cache.hits << " from the result cache)" << endl;
+
+			return 0;
 		}
 
 
 
-		// ==============  Extract Floats from String Vector  ==============
+		// ============== Streaming Mode ==============
+		/// Chunked out-of-core statistics, device memory stays bounded regardless of the input size
 
-		/// Extract temp values from raw Vector
-		for (int i = 5; i < temperatureInfo.size(); i += 6)
+		if (streamRows)
 		{
-			float temp = strtof(temperatureInfo[i].c_str(), 0);
-			temperatureValues.push_back(temp);
+			Aggregate stream_result;
+			size_t chunks = 0;
+			cl_ulong stream_time = 0;
+
+			// The blob histogram is binned chunk by chunk over its fixed range
+			unique_ptr<Histogram::Accumulator> stream_histogram;
+
+			if (histBins && !blobOut.empty())
+				stream_histogram.reset(new Histogram::Accumulator(context, queue, program, Summary::HIST_LO, Summary::HIST_HI, histBins, workgroupSize));
+
+			bool found = pipelineSlots ?
+				Streaming::RunPipelined(context, queue, program, fileDir, streamRows, workgroupSize, pipelineSlots, zeroCopy, stream_result, chunks, stream_time, stream_histogram.get()) :
+				Streaming::Run(context, queue, program, fileDir, streamRows, workgroupSize, zeroCopy, stream_result, chunks, stream_time, stream_histogram.get());
+
+			if (!found)
+			{
+				cout << "\nTemperature file was not found!" << endl;
+
+				system("pause");
+				return 0;
+			}
+
+			std::cout << "\nProgram Execution Completed!\n" << endl;
+			std::cout << "Chunks: " << chunks << " of " << streamRows << " rows" << endl << endl;
+
+			std::cout << "********************* FLOAT Results (Streamed) *********************" << endl;
+			std::cout << "Count		= " << stream_result.count << endl;
+			std::cout << "Sum		= " << stream_result.sum << endl;
+			std::cout << "Average		= " << stream_result.Mean() << endl;
+			std::cout << "Min		= " << stream_result.min << endl;
+			std::cout << "Max		= " << stream_result.max << endl;
+			std::cout << "Std Deviation   = " << stream_result.StdDev() << endl << endl;
+
+			std::cout << "Moments Time:	" << stream_time << " [ns]" << endl << endl;
+
+			Summary::Blob blob;
+			blob.aggregate = stream_result;
+
+			if (stream_histogram)
+				blob.histogram = stream_histogram->Read(queue);
+
+			if (!blobOut.empty() && !Summary::Save(blobOut, blob))
+				cout << "Summary could not be written to " << blobOut << endl;
+
+			system("pause");
+			return 0;
 		}
 
+		/// Custom Type Def
+		typedef float myType;
+
+
+		// ==============  Read temperature file into Columns  ==============
+
+		// Vectors for Parsed and Numbered Temperatures
+		TemperatureData::Records records;		/// Holds station, date, time and temperature columns
+		std::vector<myType, ZeroCopy::Allocator<myType> > temperatureValues;	/// Holds all Temperature Floats (page aligned so -zerocopy can hand it to the device)
+
+		if (!TemperatureData::LoadText(fileDir, records))
+			cout << "\nTemperature file was not found!" << endl;
+
+		/// Station, time ordered rows (the statistics do not change, the rollups and groupings read contiguous runs)
+		cl_ulong sort_time = 0;
+
+		if (sortRows)
+			StationSort::Sort(context, queue, program, records, workgroupSize, programCache, sort_time);
+
+		/// Temperature column used by the reductions
+		temperatureValues.assign(records.temperature.begin(), records.temperature.end());
+
 		/// Used to calculate Average
 		int numOfElements = temperatureValues.size();
 
@@ -131,7 +630,7 @@ int main(int argc, char **argv)
 
 		// ==============  Memory Allocation  ==============
 
-		size_t local_size = 64;												/// OpenCL device Workgroup size (Non-multiple = CL_ERRORS)
+		size_t local_size = workgroupSize;									/// OpenCL device Workgroup size (Non-multiple = CL_ERRORS)
 
 		size_t padding_size = temperatureValues.size() % local_size;		/// Amount of appenable elements ('0')
 
@@ -153,159 +652,181 @@ int main(int argc, char **argv)
 
 
 
-		// ==============  Host Output Vector ==============
-
-		// Returned values info
-		std::vector<myType> B_sum(input_elements);
-		std::vector<myType> B_min(input_elements);
-		std::vector<myType> B_max(input_elements);
-		std::vector<myType> B_std(input_elements);
-
-		// Resulting Vector Size
-		size_t output_size = B_sum.size() * sizeof(myType);
-
-
-
 		// ==============  Device Buffers  ==============
 
 		// Creates Buffers Input and Output Vectors
-		// Buffer A
-		cl::Buffer buffer_temperatures(context, CL_MEM_READ_WRITE, input_size);
+		// Buffer A (temperatureValues itself in zero-copy mode)
+		cl::Buffer buffer_temperatures = zeroCopy ?
+			ZeroCopy::Wrap(context, temperatureValues) :
+			cl::Buffer(context, CL_MEM_READ_WRITE, input_size);
+
+		// Per Workgroup partials, shared by every statistic (nr_group entries instead of input_elements per statistic)
+		Reduction::Scratch scratch(context, input_elements, local_size, sizeof(myType));
 
-		// Buffer B(s)
-		cl::Buffer buffer_B_sum(context, CL_MEM_READ_WRITE, output_size);
-		cl::Buffer buffer_B_min(context, CL_MEM_READ_WRITE, output_size);
-		cl::Buffer buffer_B_max(context, CL_MEM_READ_WRITE, output_size);
-		cl::Buffer buffer_B_std(context, CL_MEM_READ_WRITE, output_size);
+		// Specialised reductions (itemsPerThread elements per work-item, float in and out so one program serves every pass)
+		Reducer<cl_float, Op::Sum> reduce_sum(context, queue, program, program, numOfElements, local_size, itemsPerThread);
+		Reducer<cl_float, Op::SquaredDiff> reduce_std(context, queue, program, program, numOfElements, local_size, itemsPerThread);
 
 
 
 		// ==============  Device Operations  ==============
 
 		// Create device input temperature vector Buffer
-		queue.enqueueWriteBuffer(buffer_temperatures, CL_TRUE, 0, input_size, &temperatureValues[0]);
+		if (!zeroCopy)
+			queue.enqueueWriteBuffer(buffer_temperatures, CL_TRUE, 0, input_size, &temperatureValues[0]);
 
-		// Create device output vector Buffer for each test case
-		queue.enqueueFillBuffer(buffer_B_sum, 0, 0, output_size);
-		queue.enqueueFillBuffer(buffer_B_min, 0, 0, output_size);
-		queue.enqueueFillBuffer(buffer_B_max, 0, 0, output_size);
-		queue.enqueueFillBuffer(buffer_B_std, 0, 0, output_size);
 
 
+		// ============== Benchmark Mode ==============
+		/// Every variant: warmup runs, then benchRuns timed runs summing the kernel time of all of its passes
 
-		// ============== Sum FLOATS ==============
-		/// Returns the sum of all values in the first element of the vector
+		if (benchRuns)
+		{
+			size_t bytes = numOfElements * sizeof(myType);
+			float mean = reduce_sum.Run(buffer_temperatures, numOfElements) / numOfElements;
+
+			std::cout << "\nBenchmark: " << numOfElements << " elements, " << benchWarmup << " warmup + " << benchRuns << " timed runs per variant\n" << endl;
+			Benchmark::PrintHeader();
+
+			Benchmark::Print("Sum", Benchmark::Repeat(benchWarmup, benchRuns, [&]() {
+				reduce_sum.Run(buffer_temperatures, numOfElements);
+				return reduce_sum.kernel_time;
+			}), bytes, numOfElements);
+
+			Benchmark::Print("Std (squared diff)", Benchmark::Repeat(benchWarmup, benchRuns, [&]() {
+				reduce_std.Run(buffer_temperatures, numOfElements, mean);
+				return reduce_std.kernel_time;
+			}), bytes, numOfElements);
+
+			for (int largest = 0; largest < 2; largest++)
+				Benchmark::Print(largest ? "Max + row" : "Min + row", Benchmark::Repeat(benchWarmup, benchRuns, [&]() {
+					cl_ulong kernel_time;
+					ArgExtreme::Reduce(queue, program, buffer_temperatures, numOfElements, local_size, scratch, largest != 0, kernel_time);
+					return kernel_time;
+				}), bytes, numOfElements);
+
+			if (histBins)
+				Benchmark::Print("Histogram", Benchmark::Repeat(benchWarmup, benchRuns, [&]() {
+					cl_ulong kernel_time;
+					Histogram::Device(context, queue, program, buffer_temperatures, numOfElements, Summary::HIST_LO, Summary::HIST_HI, histBins, local_size, kernel_time);
+					return kernel_time;
+				}), bytes, numOfElements);
+
+			// The Sum compiled for other items per thread (each variant is its own specialised program)
+			cl::Program::Sources reduce_sources;
+			AddEmbeddedSource(reduce_sources, my_kernels_reduce_cl);
+
+			for (size_t items = 1; items <= 16; items *= 2)
+			{
+				cl::Program items_program = BuildProgram(context, reduce_sources, SpecialiseOptions<cl_float, cl_float>(workgroupSize, items), programCache);
+				Reducer<cl_float, Op::Sum> items_sum(context, queue, items_program, items_program, numOfElements, local_size, items);
+
+				Benchmark::Print("Sum (" + to_string(items) + " items/thread)", Benchmark::Repeat(benchWarmup, benchRuns, [&]() {
+					items_sum.Run(buffer_temperatures, numOfElements);
+					return items_sum.kernel_time;
+				}), bytes, numOfElements);
+			}
+
+			std::cout << endl;
+
+			system("pause");
+			return 0;
+		}
 
-		// Create Profiling Event (kernel information)
-		cl::Event profiling_event;
 
-		// Create Kernel call and set arguements
-		cl::Kernel kernel_sum = cl::Kernel(program, "reduce_sum_float");
-		kernel_sum.setArg(0, buffer_temperatures);							/// Input Vector Read Buffer
-		kernel_sum.setArg(1, buffer_B_sum);									/// Output Vector Write Buffer
-		kernel_sum.setArg(2, cl::Local(local_size * sizeof(myType)));		/// Local Memory size value
-		
-		// Queue Kernel
-		queue.enqueueNDRangeKernel(kernel_sum, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_event);
-		queue.enqueueReadBuffer(buffer_B_sum, CL_TRUE, 0, output_size, &B_sum[0]);
 
-		// Recall the Kernel as a Workgroup output Reduction-esk and Loop
-		while (B_sum[1] != 0.0f)
-		{
+		// ============== Sum FLOATS ==============
+		/// Returns the sum of all values
 
-			kernel_sum.setArg(0, buffer_B_sum);
-			kernel_sum.setArg(1, buffer_B_sum);
-			kernel_sum.setArg(2, cl::Local(local_size * sizeof(myType)));
-			queue.enqueueNDRangeKernel(kernel_sum, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_event);
-			queue.enqueueReadBuffer(buffer_B_sum, CL_TRUE, 0, output_size, &B_sum[0]);
+		myType B_sum = reduce_sum.Run(buffer_temperatures, numOfElements);
 
-		}
+		// First pass kernel information
+		cl::Event profiling_event = reduce_sum.first_event;
+		cl_ulong sum_time = reduce_sum.kernel_time;
 
 
 
 		// ============== Min Value FLOATS ==============
-		/// Returns Max value in input vector and stores it in the first element
+		/// Returns Min value in input vector and the row that recorded it
 
+		cl_ulong min_time = 0;
 
-		cl::Event profiling_min;
+		ArgExtreme::Result min_result = ArgExtreme::Reduce(queue, program, buffer_temperatures, numOfElements, local_size, scratch, false, min_time);
 
-		cl::Kernel kernel_min = cl::Kernel(program, "reduce_min_float");
-		kernel_min.setArg(0, buffer_temperatures);
-		kernel_min.setArg(1, buffer_B_min);
-		kernel_min.setArg(2, cl::Local(local_size * sizeof(myType)));
 
-		queue.enqueueNDRangeKernel(kernel_min, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_min);
-		queue.enqueueReadBuffer(buffer_B_min, CL_TRUE, 0, output_size, &B_min[0]);
 
-		while (B_min[1] != 0.0f)
-		{
-			kernel_min.setArg(0, buffer_B_min);
-			kernel_min.setArg(1, buffer_B_min);
-			kernel_min.setArg(2, cl::Local(local_size * sizeof(myType)));
-			queue.enqueueNDRangeKernel(kernel_min, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_min);
-			queue.enqueueReadBuffer(buffer_B_min, CL_TRUE, 0, output_size, &B_min[0]);
-		}
+		// ============== Max Value FLOATS ==============
+		/// Returns Max value in input vector and the row that recorded it
 
+		cl_ulong max_time = 0;
 
+		ArgExtreme::Result max_result = ArgExtreme::Reduce(queue, program, buffer_temperatures, numOfElements, local_size, scratch, true, max_time);
 
-		// ============== Max Value FLOATS ==============
-		/// Returns Max value in input vector and stores it in the first element
 
-		cl::Event profiling_max;
 
-		cl::Kernel kernel_max = cl::Kernel(program, "reduce_max_float");
-		kernel_max.setArg(0, buffer_temperatures);
-		kernel_max.setArg(1, buffer_B_max);
-		kernel_max.setArg(2, cl::Local(local_size * sizeof(myType)));
+		// ============== STD Deviation ==============
+		/// Squared distances to the Mean, one partial per Workgroup
 
-		queue.enqueueNDRangeKernel(kernel_max, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_max);
-		queue.enqueueReadBuffer(buffer_B_max, CL_TRUE, 0, output_size, &B_max[0]);
+		myType B_std = reduce_std.Run(buffer_temperatures, numOfElements, B_sum / numOfElements);
 
-		while (B_max[1] != 0.0f)
-		{
-			kernel_max.setArg(0, buffer_B_max);
-			kernel_max.setArg(1, buffer_B_max);
-			kernel_max.setArg(2, cl::Local(local_size * sizeof(myType)));
-			queue.enqueueNDRangeKernel(kernel_max, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_max);
-			queue.enqueueReadBuffer(buffer_B_max, CL_TRUE, 0, output_size, &B_max[0]);
-		}
+		cl_ulong std_time = reduce_std.kernel_time;
 
 
 
-		// ============== STD Deviation ==============
-		/// Calculates the first steps of Standard Deviation
+		// ============== Histogram ==============
+		/// Equal width bins between the Min and Max
 
-		cl::Event profiling_std;
+		std::vector<cl_uint> histogram;
+		cl_ulong hist_time = 0;
 
-		cl::Kernel kernel_std = cl::Kernel(program, "std_dev_float");
-		kernel_std.setArg(0, buffer_temperatures);
-		kernel_std.setArg(1, buffer_B_std);
-		kernel_std.setArg(2, buffer_B_sum);
-		kernel_std.setArg(3, cl::Local(local_size * sizeof(myType)));
+		if (histBins)
+			histogram = Histogram::Device(context, queue, program, buffer_temperatures, numOfElements, min_result.value, max_result.value, histBins, local_size, hist_time);
 
-		queue.enqueueNDRangeKernel(kernel_std, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_std);
-		queue.enqueueReadBuffer(buffer_B_std, CL_TRUE, 0, output_size, &B_std[0]);
 
 
-		while (B_std[1] != 0.0f)
-		{
+		// ============== Daily Rollup ==============
+		/// Reduces raw readings to one Min/Max/Mean record per station per day
+
+		std::vector<Rollup::DailyRecord> dailySeries;
+		cl_ulong daily_time = 0;
+
+		if (daily)
+			Rollup::DailyRollup(context, queue, program, records, local_size, dailySeries, daily_time);
+
+
+
+		// ============== Anomaly Detection ==============
+		/// Flags readings far from their station x month Mean (z-score) and compacts their rows
 
-			kernel_sum.setArg(0, buffer_B_std);
-			kernel_sum.setArg(1, buffer_B_std);
-			kernel_sum.setArg(2, cl::Local(local_size * sizeof(myType)));
-			queue.enqueueNDRangeKernel(kernel_sum, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_std);
-			queue.enqueueReadBuffer(buffer_B_std, CL_TRUE, 0, output_size, &B_std[0]);
+		cl::Event profiling_anomaly;
+		Anomaly::Result anomalies;
+		bool anomaliesFound = false;
 
+		if (anomalyThreshold > 0.0f)
+			anomaliesFound = Anomaly::Detect(context, queue, program, records, local_size, anomalyThreshold, anomalies, profiling_anomaly);
+
+
+
+		// ============== Top-K Extremes ==============
+		/// K hottest and coldest readings with their rows, without a full sort
+
+		std::vector<TopK::Entry> hottest, coldest;
+		cl_ulong hottest_time = 0, coldest_time = 0;
+
+		if (topK > 0)
+		{
+			TopK::Find(context, queue, program, records.temperature, topK, true, hottest, hottest_time);
+			TopK::Find(context, queue, program, records.temperature, topK, false, coldest, coldest_time);
 		}
 
 
 
 		// ============== Format Results ==============
-		float sum		= B_sum[0];
+		float sum		= B_sum;
 		float avg		= sum / numOfElements;
-		float min_value = (float)B_min[0];
-		float max_value = (float)B_max[0];
-		float variance	= (B_std[0] / B_std.size());
+		float min_value = min_result.value;
+		float max_value = max_result.value;
+		float variance	= (B_std / numOfElements);
 		float std_dev	= sqrt(variance);
 		
 
@@ -320,17 +841,91 @@ int main(int argc, char **argv)
 		std::cout << "********************* FLOAT Results *********************" << endl;
 		std::cout << "Sum		= "			<< sum << endl;
 		std::cout << "Average		= "		<< avg << endl;
-		std::cout << "Min		= "			<< min_value << endl;
-		std::cout << "Max		= "			<< max_value << endl;
+		std::cout << "Min		= "			<< min_value << "	(" << TemperatureData::Describe(records, min_result.row) << ")" << endl;
+		std::cout << "Max		= "			<< max_value << "	(" << TemperatureData::Describe(records, max_result.row) << ")" << endl;
 		std::cout << "Std Deviation   = "	<< std_dev << endl << endl;
 
 		std::cout << "********************* Profiling *********************" << endl;
-		std::cout << "AVG Time:	"	<< profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>() << " [ns]" << endl;
-		std::cout << "Min Time:	"	<< profiling_min.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_min.getProfilingInfo<CL_PROFILING_COMMAND_START>() << " [ns]" << endl;
-		std::cout << "Max Time:	"	<< profiling_max.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_max.getProfilingInfo<CL_PROFILING_COMMAND_START>() << " [ns]" << endl;
-		std::cout << "Std Time:	" << profiling_std.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_std.getProfilingInfo<CL_PROFILING_COMMAND_START>() << " [ns]" << endl << endl;
+		std::cout << "AVG Time:	"	<< sum_time << " [ns]" << endl;
+		std::cout << "Min Time:	"	<< min_time << " [ns]" << endl;
+		std::cout << "Max Time:	"	<< max_time << " [ns]" << endl;
+		std::cout << "Std Time:	" << std_time << " [ns]" << endl;
+		std::cout << "Kernel Time:	" << sum_time + min_time + max_time + std_time << " [ns] (every pass of every statistic, see -bench for repeated runs)" << endl << endl;
+
+		if (sortRows)
+			std::cout << "Sort Time:	" << sort_time << " [ns] (0 = cached order)" << endl << endl;
+
+		if (histBins)
+		{
+			std::cout << "********************* Histogram *********************" << endl;
+			Histogram::Print(histogram, min_value, max_value);
+			std::cout << "Histogram Time:	" << hist_time << " [ns]" << endl << endl;
+		}
+
+		if (!blobOut.empty())
+		{
+			Summary::Blob blob;
+			blob.aggregate.count = numOfElements;
+			blob.aggregate.sum = B_sum;
+			blob.aggregate.m2 = B_std;
+			blob.aggregate.min = min_value;
+			blob.aggregate.max = max_value;
+
+			// Fixed bins so the histograms of every shard line up
+			if (histBins)
+			{
+				cl_ulong blob_hist_time;
+				blob.histogram = Histogram::Device(context, queue, program, buffer_temperatures, numOfElements, Summary::HIST_LO, Summary::HIST_HI, histBins, local_size, blob_hist_time);
+			}
+
+			if (!Summary::Save(blobOut, blob))
+				cout << "Summary could not be written to " << blobOut << endl;
+		}
+
+		if (daily)
+		{
+			std::cout << "********************* Daily Rollup *********************" << endl;
+			std::cout << "Days		= " << dailySeries.size() << " (from " << records.size() << " readings)" << endl;
+			std::cout << "Rollup Time:	" << daily_time << " [ns]" << endl << endl;
+
+			if (!dailyDir.empty() && !Rollup::SaveBinary(dailyDir, records.stationNames, dailySeries))
+				cout << "Daily series could not be written to " << dailyDir << endl;
+		}
 
-		std::cout << "Total Program Execution Time: " << profiling_max.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>() << " ns \n" << endl;
+		if (anomalyThreshold > 0.0f)
+		{
+			std::cout << "********************* Anomalies (|z| > " << anomalyThreshold << ") *********************" << endl;
+
+			if (!anomaliesFound)
+				std::cout << "No readings, detection skipped" << endl << endl;
+			else
+			{
+				std::cout << "Count		= " << anomalies.count << endl;
+
+				/// Show the first few flagged readings with their baseline
+				for (size_t i = 0; i < anomalies.indices.size() && i < 10; i++)
+				{
+					int row = anomalies.indices[i];
+					int g = anomalies.group[row];
+					std::cout << TemperatureData::Describe(records, row) << "	" << records.temperature[row] << " (mean " << anomalies.mean[g] << ", std " << anomalies.std_dev[g] << ")" << endl;
+				}
+
+				std::cout << "Flag Time:	" << profiling_anomaly.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_anomaly.getProfilingInfo<CL_PROFILING_COMMAND_START>() << " [ns]" << endl << endl;
+			}
+		}
+
+		if (topK > 0)
+		{
+			std::cout << "********************* Top " << topK << " Hottest *********************" << endl;
+			for (const TopK::Entry& entry : hottest)
+				std::cout << TemperatureData::Describe(records, entry.row) << "	" << entry.value << endl;
+			std::cout << "Top-K Time:	" << hottest_time << " [ns]" << endl << endl;
+
+			std::cout << "********************* Top " << topK << " Coldest *********************" << endl;
+			for (const TopK::Entry& entry : coldest)
+				std::cout << TemperatureData::Describe(records, entry.row) << "	" << entry.value << endl;
+			std::cout << "Top-K Time:	" << coldest_time << " [ns]" << endl << endl;
+		}
 
 	}
 	catch (cl::Error err) {
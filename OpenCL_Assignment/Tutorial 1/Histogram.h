@@ -0,0 +1,102 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+using namespace std;
+
+namespace Histogram {
+
+	// Device bins over [lo, hi] that every Add launch of hist_float accumulates into (e.g. one launch per streamed chunk)
+	struct Accumulator {
+		cl::Buffer buffer_hist;
+		cl::Kernel kernel_hist;
+		size_t bins = 0;
+		size_t local_size = 0;
+		bool local_bins = true;		/// Workgroups count into local bins first (false = hist_global_float, the bins exceed local memory)
+
+		Accumulator(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, float lo, float hi, size_t bins, size_t local_size)
+			: bins(bins), local_size(local_size)
+		{
+			// Waited for, the launches may come from another queue
+			cl::Event cleared;
+			buffer_hist = cl::Buffer(context, CL_MEM_READ_WRITE, bins * sizeof(cl_uint));
+			queue.enqueueFillBuffer(buffer_hist, (cl_uint)0, 0, bins * sizeof(cl_uint), NULL, &cleared);
+			cleared.wait();
+
+			/* Bin counters:
+
+				Each Workgroup keeps a private copy of the bins in local memory and flushes it once.
+				When the bins do not fit (about 16K bins on 64KB of local memory) every reading increments
+				the global bins directly, slower under contention but independent of the bin count
+			*/
+			cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+			local_bins = bins * sizeof(cl_uint) <= device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+
+			kernel_hist = cl::Kernel(program, local_bins ? "hist_float" : "hist_global_float");
+			kernel_hist.setArg(1, buffer_hist);
+
+			if (local_bins) {
+				kernel_hist.setArg(2, cl::Local(bins * sizeof(cl_uint)));
+				kernel_hist.setArg(3, (cl_float)lo);
+				kernel_hist.setArg(4, (cl_float)hi);
+				kernel_hist.setArg(5, (cl_int)bins);
+			}
+			else {
+				kernel_hist.setArg(2, (cl_float)lo);
+				kernel_hist.setArg(3, (cl_float)hi);
+				kernel_hist.setArg(4, (cl_int)bins);
+			}
+		}
+
+		// Bin the first `elements` values of buffer_values (the arguments are captured at enqueue, the kernel can be reused straight away)
+		cl::Event Add(const cl::CommandQueue& queue, const cl::Buffer& buffer_values, size_t elements)
+		{
+			size_t global_size = ((elements + local_size - 1) / local_size) * local_size;
+
+			kernel_hist.setArg(0, buffer_values);
+			kernel_hist.setArg(local_bins ? 6 : 5, (cl_int)elements);
+
+			cl::Event profiling_event;
+			queue.enqueueNDRangeKernel(kernel_hist, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size), NULL, &profiling_event);
+
+			return profiling_event;
+		}
+
+		vector<cl_uint> Read(const cl::CommandQueue& queue)
+		{
+			vector<cl_uint> result(bins, 0);
+			queue.enqueueReadBuffer(buffer_hist, CL_TRUE, 0, bins * sizeof(cl_uint), &result[0]);
+
+			return result;
+		}
+	};
+
+	// Equal width histogram of the first `elements` values of buffer_values over [lo, hi] (matches CpuBackend::Histogram)
+	vector<cl_uint> Device(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, const cl::Buffer& buffer_values, size_t elements, float lo, float hi, size_t bins, size_t local_size, cl_ulong& kernel_time)
+	{
+		Accumulator histogram(context, queue, program, lo, hi, bins, local_size);
+
+		cl::Event profiling_event = histogram.Add(queue, buffer_values, elements);
+		vector<cl_uint> result = histogram.Read(queue);
+
+		kernel_time = profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+
+		return result;
+	}
+
+	// One "[lo, hi)  count" line per bin
+	void Print(const vector<cl_uint>& counts, float lo, float hi)
+	{
+		float width = counts.empty() ? 0.0f : (hi - lo) / counts.size();
+
+		for (size_t b = 0; b < counts.size(); b++)
+			std::cout << "[" << lo + b * width << ", " << lo + (b + 1) * width << ")	" << counts[b] << endl;
+	}
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+#include "Aggregate.h"
+#include "Histogram.h"
+#include "Utils.h"
+
+using namespace std;
+
+/* Statistics split across several OpenCL devices:
+
+	Every device gets its own context, queue and program. A short calibration run measures each device's
+	throughput (upload + kernel + readback), the input is then split into contiguous slices proportional to it.
+	The slices are reduced concurrently (one host thread per device) to per Workgroup moments and merged on the host.
+	CPU devices can be split into one sub-device per NUMA node, each then reducing a slice held in memory its own kernel touched first
+*/
+namespace MultiDevice {
+
+	// One device taking part in a multi-device run
+	struct Worker {
+		cl::Device device;
+		cl::Context context;
+		cl::CommandQueue queue;
+		cl::Program program;
+		double throughput = 0.0;	/// Rows per second measured by Calibrate
+		size_t first = 0;			/// Slice of the input assigned to this device
+		size_t rows = 0;
+		Aggregate result;			/// Statistics of the slice
+		cl_ulong kernel_time = 0;
+		bool numa_local = false;	/// Slice copied into pages the sub-device placed on its node rather than transferred
+		size_t hist_bins = 0;		/// Bins of the slice's histogram over [hist_lo, hist_hi] (0 = none)
+		float hist_lo = 0.0f;
+		float hist_hi = 0.0f;
+		vector<cl_uint> histogram;
+	};
+
+	// Devices named by "all" (every device of every platform) or a comma separated "platform:device" list
+	vector<cl::Device> Devices(const string& list)
+	{
+		vector<cl::Platform> platforms;
+		cl::Platform::get(&platforms);
+
+		vector<cl::Device> selected;
+
+		if (list == "all") {
+			for (cl::Platform& platform : platforms) {
+				vector<cl::Device> devices;
+				platform.getDevices((cl_device_type)CL_DEVICE_TYPE_ALL, &devices);
+				selected.insert(selected.end(), devices.begin(), devices.end());
+			}
+
+			return selected;
+		}
+
+		size_t start = 0;
+
+		while (start < list.size()) {
+			size_t end = list.find(',', start);
+
+			if (end == string::npos)
+				end = list.size();
+
+			string entry = list.substr(start, end - start);
+			size_t colon = entry.find(':');
+			int platform_id = atoi(entry.substr(0, colon).c_str());
+			int device_id = colon == string::npos ? 0 : atoi(entry.substr(colon + 1).c_str());
+
+			if (platform_id >= 0 && platform_id < (int)platforms.size()) {
+				vector<cl::Device> devices;
+				platforms[platform_id].getDevices((cl_device_type)CL_DEVICE_TYPE_ALL, &devices);
+
+				if (device_id >= 0 && device_id < (int)devices.size())
+					selected.push_back(devices[device_id]);
+			}
+
+			start = end + 1;
+		}
+
+		return selected;
+	}
+
+	// True for OpenCL 1.2 or later devices (CL_DEVICE_VERSION = "OpenCL <major>.<minor> ...")
+	bool Supports12(const cl::Device& device)
+	{
+		int major = 0, minor = 0;
+		sscanf(device.getInfo<CL_DEVICE_VERSION>().c_str(), "OpenCL %d.%d", &major, &minor);
+
+		return major > 1 || (major == 1 && minor >= 2);
+	}
+
+	// One sub-device per NUMA node of a CPU device ({ device } when it cannot be partitioned by affinity domain)
+	vector<cl::Device> NumaSubDevices(cl::Device device)
+	{
+		// Partitioning (and its device queries) arrived with OpenCL 1.2, 1.1 CPU runtimes throw CL_INVALID_VALUE
+		if (!(device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU) || !Supports12(device))
+			return { device };
+
+		if (!(device.getInfo<CL_DEVICE_PARTITION_AFFINITY_DOMAIN>() & CL_DEVICE_AFFINITY_DOMAIN_NUMA))
+			return { device };
+
+		const cl_device_partition_property properties[] = { CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, CL_DEVICE_AFFINITY_DOMAIN_NUMA, 0 };
+		vector<cl::Device> sub_devices;
+
+		// Single node hosts report CL_DEVICE_PARTITION_FAILED
+		try {
+			device.createSubDevices(properties, &sub_devices);
+		}
+		catch (const cl::Error&) {
+			return { device };
+		}
+
+		if (sub_devices.empty())
+			return { device };
+
+		return sub_devices;
+	}
+
+	// Context, profiling queue and program of a single device, built with options (e.g. the specialisation for the run's Workgroup size)
+	Worker CreateWorker(const cl::Device& device, const cl::Program::Sources& sources, const string& options, const string& cache_dir)
+	{
+		Worker worker;
+		worker.device = device;
+		worker.context = cl::Context({ device });
+		worker.queue = cl::CommandQueue(worker.context, CL_QUEUE_PROFILING_ENABLE);
+		worker.program = BuildProgram(worker.context, sources, options, cache_dir);
+
+		return worker;
+	}
+
+	// Moments of rows values on one device: upload, reduce_moments_float, read back and merge the Workgroup partials
+	Aggregate Reduce(Worker& worker, const float* values, size_t rows, size_t local_size, cl_ulong& kernel_time)
+	{
+		Aggregate result;
+
+		if (!rows)
+			return result;
+
+		size_t nr_group = (rows + local_size - 1) / local_size;
+		vector<Moments> partials(nr_group);
+
+		cl_mem_flags host_flags = worker.numa_local ? CL_MEM_ALLOC_HOST_PTR : 0;
+		cl::Buffer buffer_values(worker.context, CL_MEM_READ_ONLY | host_flags, nr_group * local_size * sizeof(cl_float));
+		cl::Buffer buffer_moments(worker.context, CL_MEM_WRITE_ONLY, nr_group * sizeof(Moments));
+
+		if (worker.numa_local) {
+			/* First touch placement:
+
+				The host thread running this is not pinned, so its first write would place the pages on whatever node it runs on.
+				The runtime runs the sub-device's kernels on the cores of its node, so a kernel touches them first and the
+				mapping then fills pages already on that node
+			*/
+			cl::Kernel kernel_touch = cl::Kernel(worker.program, "touch_float");
+			kernel_touch.setArg(0, buffer_values);
+			worker.queue.enqueueNDRangeKernel(kernel_touch, cl::NullRange, cl::NDRange(nr_group * local_size), cl::NullRange);
+
+			cl_float* mapped = (cl_float*)worker.queue.enqueueMapBuffer(buffer_values, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, rows * sizeof(cl_float));
+			copy(values, values + rows, mapped);
+			worker.queue.enqueueUnmapMemObject(buffer_values, mapped);
+		}
+		else {
+			worker.queue.enqueueWriteBuffer(buffer_values, CL_FALSE, 0, rows * sizeof(cl_float), values);
+		}
+
+		cl::Kernel kernel_moments = cl::Kernel(worker.program, "reduce_moments_float");
+		kernel_moments.setArg(0, buffer_values);
+		kernel_moments.setArg(1, buffer_moments);
+		kernel_moments.setArg(2, cl::Local(local_size * sizeof(cl_float)));
+		kernel_moments.setArg(3, cl::Local(local_size * sizeof(cl_float)));
+		kernel_moments.setArg(4, cl::Local(local_size * sizeof(cl_float)));
+		kernel_moments.setArg(5, cl::Local(local_size * sizeof(cl_float)));
+		kernel_moments.setArg(6, (cl_int)rows);
+
+		cl::Event profiling_event;
+		worker.queue.enqueueNDRangeKernel(kernel_moments, cl::NullRange, cl::NDRange(nr_group * local_size), cl::NDRange(local_size), NULL, &profiling_event);
+		worker.queue.enqueueReadBuffer(buffer_moments, CL_TRUE, 0, nr_group * sizeof(Moments), &partials[0]);
+
+		kernel_time = profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+
+		for (const Moments& partial : partials)
+			result.Merge(partial);
+
+		// Binned while the slice is still on the device
+		if (worker.hist_bins) {
+			cl_ulong hist_time;
+			worker.histogram = Histogram::Device(worker.context, worker.queue, worker.program, buffer_values, rows, worker.hist_lo, worker.hist_hi, worker.hist_bins, local_size, hist_time);
+		}
+
+		return result;
+	}
+
+	const size_t CALIBRATION_ROWS = 1 << 20;	/// Smallest calibration sample, large enough for the launch overhead not to dominate
+
+	// Rows each worker is timed on: an eighth of the input, at least CALIBRATION_ROWS (all of it when smaller)
+	size_t SampleRows(size_t rows)
+	{
+		return min(rows, max(CALIBRATION_ROWS, rows / 8));
+	}
+
+	// Measure every worker's rows per second on the first sample_rows values (includes transfers, warms up the driver)
+	void Calibrate(vector<Worker>& workers, const vector<float>& values, size_t sample_rows, size_t local_size)
+	{
+		sample_rows = min(sample_rows, values.size());
+
+		for (Worker& worker : workers) {
+			cl_ulong kernel_time;
+
+			// First run pays the one-off kernel compilation/allocation costs
+			Reduce(worker, values.data(), sample_rows, local_size, kernel_time);
+
+			auto start = chrono::steady_clock::now();
+			Reduce(worker, values.data(), sample_rows, local_size, kernel_time);
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+			worker.throughput = sample_rows / max(seconds, 1e-9);
+		}
+	}
+
+	// Split values proportionally to the workers' throughput (whole Workgroups), reduce the slices concurrently and merge
+	Aggregate Run(vector<Worker>& workers, const vector<float>& values, size_t local_size)
+	{
+		double total_throughput = 0.0;
+
+		for (const Worker& worker : workers)
+			total_throughput += worker.throughput;
+
+		// Uncalibrated workers share the input evenly
+		if (total_throughput <= 0.0) {
+			for (Worker& worker : workers)
+				worker.throughput = 1.0;
+
+			total_throughput = (double)workers.size();
+		}
+
+		size_t groups = (values.size() + local_size - 1) / local_size;
+		size_t remaining = groups;
+		size_t first = 0;
+
+		for (size_t w = 0; w < workers.size(); w++) {
+			size_t share = (w + 1 == workers.size()) ? remaining : (size_t)(groups * workers[w].throughput / total_throughput);
+			share = min(share, remaining);
+			remaining -= share;
+
+			workers[w].first = first;
+			workers[w].rows = min(share * local_size, values.size() - first);
+			first += workers[w].rows;
+		}
+
+		vector<thread> threads;
+		vector<exception_ptr> errors(workers.size());
+
+		for (size_t w = 0; w < workers.size(); w++)
+			threads.push_back(thread([&workers, &errors, &values, local_size, w]() {
+				Worker& worker = workers[w];
+
+				// cl::Error must reach main's handler, not terminate the thread
+				try {
+					worker.result = Reduce(worker, values.data() + worker.first, worker.rows, local_size, worker.kernel_time);
+				}
+				catch (...) {
+					errors[w] = current_exception();
+				}
+			}));
+
+		for (thread& t : threads)
+			t.join();
+
+		for (exception_ptr& error : errors)
+			if (error)
+				rethrow_exception(error);
+
+		Aggregate result;
+
+		for (const Worker& worker : workers)
+			result.Merge(worker.result);
+
+		return result;
+	}
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+#include "Aggregate.h"
+#include "TemperatureData.h"
+
+using namespace std;
+
+/* Range statistics of one station's time ordered series without a scan:
+
+	The readings are ordered by (station, date, time) so every station is a contiguous, date sorted slice.
+	Count, Sum and Std Deviation come from integer prefix sums of the tenths of a degree (O(1), M2 without overflow or cancellation at any slice size). Min/Max come from a sparse table over blocks of BLOCK rows,
+	built on the device: level 0 is reduce_min_t/reduce_max_t of a leaf program specialised for BLOCK sized Workgroups,
+	every further level is one sparse_level_float pass. A query looks up two overlapping power of two runs of whole blocks
+	and scans at most two partial blocks, keeping the tables at (N / BLOCK) * log2(N / BLOCK) entries instead of N * log2(N)
+*/
+namespace RangeIndex {
+
+	const size_t BLOCK = 32;		/// Rows per leaf of the sparse tables (the Workgroup size of the level 0 pass)
+
+	struct Index {
+		vector<size_t> first;			/// Station s owns rows [first[s], first[s + 1])
+		vector<int> date;				/// yyyymmdd of each ordered row
+		vector<float> values;			/// Temperature of each ordered row
+		vector<long long> prefix_sum;	/// Sum / sum of squares of the tenths of rows [0, i)
+		vector<long long> prefix_sq;
+		vector<float> min_table;		/// levels x blocks, level k covers 2^k blocks
+		vector<float> max_table;
+		size_t blocks = 0;
+		size_t levels = 0;
+	};
+
+	// Order the readings (unless already ordered), build the prefix sums on the host and the Min/Max sparse tables on the device
+	/// leaf_program = my_kernels_reduce.cl built with SpecialiseOptions<cl_float, cl_float>(BLOCK, 1), program holds sparse_level_float
+	Index Build(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, const cl::Program& leaf_program, const TemperatureData::Records& records, cl_ulong& kernel_time)
+	{
+		Index index;
+		size_t rows = records.size();
+		kernel_time = 0;
+
+		vector<size_t> order(rows);
+
+		for (size_t i = 0; i < rows; i++)
+			order[i] = i;
+
+		auto before = [&](size_t a, size_t b) {
+			if (records.station[a] != records.station[b]) return records.station[a] < records.station[b];
+			if (records.date[a] != records.date[b]) return records.date[a] < records.date[b];
+			return records.time[a] < records.time[b];
+		};
+
+		// Rows StationSort already ordered only cost the linear check
+		if (!is_sorted(order.begin(), order.end(), before))
+			sort(order.begin(), order.end(), before);
+
+		index.first.assign(records.stationNames.size() + 1, 0);
+		index.date.resize(rows);
+		index.values.resize(rows);
+		index.prefix_sum.assign(rows + 1, 0);
+		index.prefix_sq.assign(rows + 1, 0);
+
+		for (size_t i = 0; i < rows; i++)
+		{
+			float value = records.temperature[order[i]];
+			long long tenths = lround(value * 10.0f);
+
+			index.date[i] = records.date[order[i]];
+			index.values[i] = value;
+			index.prefix_sum[i + 1] = index.prefix_sum[i] + tenths;
+			index.prefix_sq[i + 1] = index.prefix_sq[i] + tenths * tenths;
+			index.first[records.station[order[i]] + 1]++;
+		}
+
+		for (size_t s = 1; s < index.first.size(); s++)
+			index.first[s] += index.first[s - 1];
+
+		if (!rows)
+			return index;
+
+		index.blocks = (rows + BLOCK - 1) / BLOCK;
+		index.levels = 1;
+
+		while (((size_t)1 << index.levels) <= index.blocks)
+			index.levels++;
+
+		size_t table_size = index.levels * index.blocks * sizeof(cl_float);
+
+		// The leaf kernels skip rows past the end, the tail block needs no padding
+		cl::Buffer buffer_values(context, CL_MEM_READ_ONLY, rows * sizeof(cl_float));
+		queue.enqueueWriteBuffer(buffer_values, CL_FALSE, 0, rows * sizeof(cl_float), &index.values[0]);
+
+		for (int largest = 0; largest < 2; largest++)
+		{
+			cl::Buffer buffer_table(context, CL_MEM_READ_WRITE, table_size);
+
+			// Level 0 is the first blocks entries of the table, one partial per BLOCK rows
+			cl::Kernel kernel_leaves = cl::Kernel(leaf_program, largest ? "reduce_max_t" : "reduce_min_t");
+			kernel_leaves.setArg(0, buffer_values);
+			kernel_leaves.setArg(1, buffer_table);
+			kernel_leaves.setArg(2, (cl_int)rows);
+
+			cl::Event profiling_event;
+			queue.enqueueNDRangeKernel(kernel_leaves, cl::NullRange, cl::NDRange(index.blocks * BLOCK), cl::NDRange(BLOCK), NULL, &profiling_event);
+			profiling_event.wait();
+			kernel_time += profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+
+			cl::Kernel kernel_level = cl::Kernel(program, "sparse_level_float");
+			kernel_level.setArg(0, buffer_table);
+			kernel_level.setArg(1, (cl_int)index.blocks);
+			kernel_level.setArg(3, (cl_int)largest);
+
+			// Each level reads the previous one, the in-order queue keeps them in sequence
+			for (size_t level = 1; level < index.levels; level++)
+			{
+				kernel_level.setArg(2, (cl_int)level);
+
+				queue.enqueueNDRangeKernel(kernel_level, cl::NullRange, cl::NDRange(index.blocks), cl::NullRange, NULL, &profiling_event);
+				profiling_event.wait();
+				kernel_time += profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+			}
+
+			vector<float>& table = largest ? index.max_table : index.min_table;
+			table.resize(index.levels * index.blocks);
+			queue.enqueueReadBuffer(buffer_table, CL_TRUE, 0, table_size, &table[0]);
+		}
+
+		return index;
+	}
+
+	// Min and Max of the ordered rows [first, end), first < end
+	void Extremes(const Index& index, size_t first, size_t end, float& min_value, float& max_value)
+	{
+		min_value = FLT_MAX;
+		max_value = -FLT_MAX;
+
+		// Whole blocks [first_block, end_block) come from the tables
+		size_t first_block = (first + BLOCK - 1) / BLOCK;
+		size_t end_block = end / BLOCK;
+
+		size_t scan_end = first_block < end_block ? first_block * BLOCK : end;
+
+		for (size_t i = first; i < scan_end; i++) {
+			min_value = min(min_value, index.values[i]);
+			max_value = max(max_value, index.values[i]);
+		}
+
+		if (first_block >= end_block)
+			return;
+
+		for (size_t i = end_block * BLOCK; i < end; i++) {
+			min_value = min(min_value, index.values[i]);
+			max_value = max(max_value, index.values[i]);
+		}
+
+		size_t level = 0;
+
+		while (((size_t)2 << level) <= end_block - first_block)
+			level++;
+
+		size_t a = level * index.blocks + first_block;
+		size_t b = level * index.blocks + end_block - ((size_t)1 << level);
+
+		min_value = min(min_value, min(index.min_table[a], index.min_table[b]));
+		max_value = max(max_value, max(index.max_table[a], index.max_table[b]));
+	}
+
+	// Statistics of station's readings (-1 = every station) between date_from and date_to (inclusive yyyymmdd)
+	Aggregate Query(const Index& index, int station, int date_from, int date_to)
+	{
+		Aggregate result;
+
+		size_t first_station = station < 0 ? 0 : (size_t)station;
+		size_t end_station = station < 0 ? index.first.size() - 1 : first_station + 1;
+
+		for (size_t s = first_station; s < end_station; s++)
+		{
+			auto begin = index.date.begin() + index.first[s];
+			auto end = index.date.begin() + index.first[s + 1];
+
+			size_t first = lower_bound(begin, end, date_from) - index.date.begin();
+			size_t last = upper_bound(begin, end, date_to) - index.date.begin();
+
+			if (first >= last)
+				continue;
+
+			long long n = last - first;
+			long long sum_tenths = index.prefix_sum[last] - index.prefix_sum[first];
+			long long sq_tenths = index.prefix_sq[last] - index.prefix_sq[first];
+
+			// M2 = Sum(x^2) - Sum(x)^2 / n in tenths^2, with Sum(x) = q * n + r: Sum(x)^2 / n = Sum(x) * q + Sum(x) * r / n.
+			// 0 <= Sum(x) * q <= Sum(x^2), so the large terms cancel exactly in integers (n * Sum(x^2) would overflow past ~3e7 rows)
+			long long q = sum_tenths / n;
+			long long r = sum_tenths % n;
+
+			Aggregate slice;
+			slice.count = n;
+			slice.sum = sum_tenths / 10.0;
+			slice.m2 = ((double)(sq_tenths - sum_tenths * q) - (double)sum_tenths * r / n) / 100.0;
+			Extremes(index, first, last, slice.min, slice.max);
+
+			result.Merge(slice);
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+using namespace std;
+
+namespace Reduction {
+
+	/* Device scratch shared by every multi-pass reduction of an input:
+
+		A pass only produces one value per Workgroup, so two ping-pong buffers of nr_group entries
+		(plus a matching pair of row buffers for the value+index reductions) hold every pass of every statistic.
+		Capacity is rounded up to whole Workgroups so the second pass can read its padded tail
+	*/
+	struct Scratch {
+		cl::Buffer partials[2];
+		cl::Buffer rows[2];
+		size_t capacity;		/// Entries per buffer (>= first pass Workgroups)
+
+		Scratch(const cl::Context& context, size_t input_elements, size_t local_size, size_t element_size)
+		{
+			size_t nr_group = (input_elements + local_size - 1) / local_size;
+			capacity = ((nr_group + local_size - 1) / local_size) * local_size;
+
+			for (int i = 0; i < 2; i++) {
+				partials[i] = cl::Buffer(context, CL_MEM_READ_WRITE, capacity * element_size);
+				rows[i] = cl::Buffer(context, CL_MEM_READ_WRITE, capacity * sizeof(cl_int));
+			}
+		}
+	};
+}
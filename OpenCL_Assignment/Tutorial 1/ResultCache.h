@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "Aggregate.h"
+#include "TemperatureData.h"
+#include "Utils.h"
+
+using namespace std;
+
+/* Answers of repeated queries without a kernel launch:
+
+	Results are keyed by the dataset fingerprint and the query's filter predicate. The cached value is the whole Aggregate,
+	so count/sum/mean/min/max/std of the same filter all share one entry.
+	Entries live in an in-memory LRU list and, with a cache directory, also as result_<hash of the key>.bin files
+	that outlive the process (a new dataset has a new fingerprint, so stale files are never hit).
+	Every file holds its full key, so a file whose key hash collides with another key's is a miss rather than a wrong answer
+*/
+namespace ResultCache {
+
+	// FNV-1a of the station names and the station, date, time and temperature columns
+	unsigned long long Fingerprint(const TemperatureData::Records& records)
+	{
+		unsigned long long hash = HashString("");
+
+		for (const string& name : records.stationNames) {
+			hash = HashString(name, hash);
+			hash = HashString("\n", hash);
+		}
+
+		hash = HashBytes(records.station.data(), records.station.size() * sizeof(int), hash);
+		hash = HashBytes(records.date.data(), records.date.size() * sizeof(int), hash);
+		hash = HashBytes(records.time.data(), records.time.size() * sizeof(int), hash);
+		hash = HashBytes(records.temperature.data(), records.temperature.size() * sizeof(float), hash);
+
+		return hash;
+	}
+
+	/* Cached result layout (host byte order):
+
+		"TRES" | uint32 key length | key | int64 count | double sum | double m2 | float min | float max
+	*/
+	bool SaveEntry(const string& fileDir, const string& key, const Aggregate& result)
+	{
+		ofstream file(fileDir, ios::binary);
+
+		if (!file.is_open())
+			return false;
+
+		unsigned int length = (unsigned int)key.size();
+
+		file.write("TRES", 4);
+		file.write((const char*)&length, sizeof(length));
+		file.write(key.data(), length);
+		file.write((const char*)&result.count, sizeof(result.count));
+		file.write((const char*)&result.sum, sizeof(result.sum));
+		file.write((const char*)&result.m2, sizeof(result.m2));
+		file.write((const char*)&result.min, sizeof(result.min));
+		file.write((const char*)&result.max, sizeof(result.max));
+
+		return file.good();
+	}
+
+	// False if the file is missing, truncated, not an entry or holds another key
+	bool LoadEntry(const string& fileDir, const string& key, Aggregate& result)
+	{
+		ifstream file(fileDir, ios::binary);
+
+		if (!file.is_open())
+			return false;
+
+		char magic[4];
+		unsigned int length = 0;
+
+		file.read(magic, 4);
+		file.read((char*)&length, sizeof(length));
+
+		if (!file || memcmp(magic, "TRES", 4) != 0 || length != key.size())
+			return false;
+
+		string stored(length, '\0');
+		file.read(&stored[0], length);
+
+		if (!file || stored != key)
+			return false;
+
+		Aggregate entry;
+		file.read((char*)&entry.count, sizeof(entry.count));
+		file.read((char*)&entry.sum, sizeof(entry.sum));
+		file.read((char*)&entry.m2, sizeof(entry.m2));
+		file.read((char*)&entry.min, sizeof(entry.min));
+		file.read((char*)&entry.max, sizeof(entry.max));
+
+		if (!file)
+			return false;
+
+		result = entry;
+		return true;
+	}
+
+	class Lru {
+	public:
+		size_t hits = 0;
+		size_t misses = 0;
+
+		// capacity = in-memory entries (0 = no memory cache), empty cache_dir = no on-disk cache
+		Lru(unsigned long long fingerprint, size_t capacity, const string& cache_dir = "")
+			: fingerprint(fingerprint), capacity(capacity), cache_dir(cache_dir) {}
+
+		// Cached result of predicate (memory first, then disk)
+		bool Get(const string& predicate, Aggregate& result)
+		{
+			string key = Key(predicate);
+			auto found = index.find(key);
+
+			if (found != index.end()) {
+				// Most recently used first
+				entries.splice(entries.begin(), entries, found->second);
+				result = found->second->second;
+				hits++;
+				return true;
+			}
+
+			if (!cache_dir.empty() && LoadEntry(Path(key), key, result)) {
+				Remember(key, result);
+				hits++;
+				return true;
+			}
+
+			misses++;
+			return false;
+		}
+
+		void Put(const string& predicate, const Aggregate& result)
+		{
+			string key = Key(predicate);
+			Remember(key, result);
+
+			if (!cache_dir.empty())
+				SaveEntry(Path(key), key, result);
+		}
+
+	private:
+		unsigned long long fingerprint;
+		size_t capacity;
+		string cache_dir;
+		list<pair<string, Aggregate>> entries;		/// Most recently used first
+		unordered_map<string, list<pair<string, Aggregate>>::iterator> index;
+
+		string Key(const string& predicate) const
+		{
+			char dataset[20];
+			snprintf(dataset, sizeof(dataset), "%016llx|", fingerprint);
+
+			return dataset + predicate;
+		}
+
+		string Path(const string& key) const
+		{
+			char file_name[32];
+			snprintf(file_name, sizeof(file_name), "result_%016llx.bin", HashString(key));
+
+			return cache_dir + "/" + file_name;
+		}
+
+		void Remember(const string& key, const Aggregate& result)
+		{
+			if (!capacity)
+				return;
+
+			auto found = index.find(key);
+
+			if (found != index.end()) {
+				found->second->second = result;
+				entries.splice(entries.begin(), entries, found->second);
+				return;
+			}
+
+			if (entries.size() == capacity) {
+				index.erase(entries.back().first);
+				entries.pop_back();
+			}
+
+			entries.push_front(make_pair(key, result));
+			index[key] = entries.begin();
+		}
+	};
+}
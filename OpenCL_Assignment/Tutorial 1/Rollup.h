@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <fstream>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+#include "TemperatureData.h"
+
+using namespace std;
+
+namespace Rollup {
+
+	// One compact record per station per day
+	struct DailyRecord {
+		cl_int station;		/// Station index (see Records::stationNames)
+		cl_int date;		/// yyyymmdd
+		cl_float tmin;
+		cl_float tmax;
+		cl_float tmean;
+		cl_int count;		/// Number of raw readings that day
+	};
+
+	// Give every reading the index of its (station, date) pair in the sorted list of distinct days
+	void BuildDayIndex(const TemperatureData::Records& records, vector<cl_int>& dayIndex, vector<DailyRecord>& days)
+	{
+		vector<long long> keys(records.size());
+
+		for (size_t i = 0; i < records.size(); i++)
+			keys[i] = ((long long)records.station[i] << 32) | records.date[i];
+
+		vector<long long> distinct(keys);
+		sort(distinct.begin(), distinct.end());
+		distinct.erase(unique(distinct.begin(), distinct.end()), distinct.end());
+
+		dayIndex.resize(keys.size());
+
+		for (size_t i = 0; i < keys.size(); i++)
+			dayIndex[i] = (cl_int)(lower_bound(distinct.begin(), distinct.end(), keys[i]) - distinct.begin());
+
+		days.resize(distinct.size());
+
+		for (size_t d = 0; d < distinct.size(); d++)
+		{
+			days[d].station = (cl_int)(distinct[d] >> 32);
+			days[d].date = (cl_int)(distinct[d] & 0xFFFFFFFF);
+		}
+	}
+
+	// Reduce the raw readings to one DailyRecord per station per day on the device
+	void DailyRollup(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, const TemperatureData::Records& records, size_t local_size, vector<DailyRecord>& days, cl_ulong& kernel_time)
+	{
+		days.clear();
+		kernel_time = 0;
+
+		// No readings = no days (and no zero sized Buffers)
+		if (!records.size())
+			return;
+
+		vector<cl_int> dayIndex;
+		BuildDayIndex(records, dayIndex, days);
+
+		size_t input_elements = records.size();
+		size_t nr_days = days.size();
+		size_t global_size = ((input_elements + local_size - 1) / local_size) * local_size;
+
+		// Device Buffers
+		cl::Buffer buffer_values(context, CL_MEM_READ_ONLY, input_elements * sizeof(cl_float));
+		cl::Buffer buffer_day(context, CL_MEM_READ_ONLY, input_elements * sizeof(cl_int));
+		cl::Buffer buffer_min(context, CL_MEM_READ_WRITE, nr_days * sizeof(cl_float));
+		cl::Buffer buffer_max(context, CL_MEM_READ_WRITE, nr_days * sizeof(cl_float));
+		cl::Buffer buffer_sum(context, CL_MEM_READ_WRITE, nr_days * sizeof(cl_float));
+		cl::Buffer buffer_count(context, CL_MEM_READ_WRITE, nr_days * sizeof(cl_int));
+
+		queue.enqueueWriteBuffer(buffer_values, CL_TRUE, 0, input_elements * sizeof(cl_float), &records.temperature[0]);
+		queue.enqueueWriteBuffer(buffer_day, CL_TRUE, 0, input_elements * sizeof(cl_int), &dayIndex[0]);
+
+		queue.enqueueFillBuffer(buffer_min, (cl_float)FLT_MAX, 0, nr_days * sizeof(cl_float));
+		queue.enqueueFillBuffer(buffer_max, (cl_float)-FLT_MAX, 0, nr_days * sizeof(cl_float));
+		queue.enqueueFillBuffer(buffer_sum, (cl_float)0, 0, nr_days * sizeof(cl_float));
+		queue.enqueueFillBuffer(buffer_count, (cl_int)0, 0, nr_days * sizeof(cl_int));
+
+		cl::Kernel kernel_rollup = cl::Kernel(program, "rollup_daily_float");
+		kernel_rollup.setArg(0, buffer_values);
+		kernel_rollup.setArg(1, buffer_day);
+		kernel_rollup.setArg(2, buffer_min);
+		kernel_rollup.setArg(3, buffer_max);
+		kernel_rollup.setArg(4, buffer_sum);
+		kernel_rollup.setArg(5, buffer_count);
+		kernel_rollup.setArg(6, (cl_int)input_elements);
+
+		cl::Event profiling_event;
+		queue.enqueueNDRangeKernel(kernel_rollup, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size), NULL, &profiling_event);
+
+		// Compact per-day outputs
+		vector<cl_float> tmin(nr_days), tmax(nr_days), tsum(nr_days);
+		vector<cl_int> count(nr_days);
+
+		queue.enqueueReadBuffer(buffer_min, CL_TRUE, 0, nr_days * sizeof(cl_float), &tmin[0]);
+		queue.enqueueReadBuffer(buffer_max, CL_TRUE, 0, nr_days * sizeof(cl_float), &tmax[0]);
+		queue.enqueueReadBuffer(buffer_sum, CL_TRUE, 0, nr_days * sizeof(cl_float), &tsum[0]);
+		queue.enqueueReadBuffer(buffer_count, CL_TRUE, 0, nr_days * sizeof(cl_int), &count[0]);
+
+		kernel_time = profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+
+		for (size_t d = 0; d < nr_days; d++)
+		{
+			days[d].tmin = tmin[d];
+			days[d].tmax = tmax[d];
+			days[d].tmean = tsum[d] / count[d];
+			days[d].count = count[d];
+		}
+	}
+
+	/* Binary daily series layout:
+
+		"TDLY" | uint32 station count | per station: uint32 name length + name bytes | uint64 day count | DailyRecord[day count]
+	*/
+	bool SaveBinary(const string& fileDir, const vector<string>& stationNames, const vector<DailyRecord>& days)
+	{
+		ofstream file(fileDir, ios::binary);
+
+		if (!file.is_open())
+			return false;
+
+		unsigned int nr_stations = (unsigned int)stationNames.size();
+		unsigned long long nr_days = days.size();
+
+		file.write("TDLY", 4);
+		file.write((const char*)&nr_stations, sizeof(nr_stations));
+
+		for (const string& name : stationNames)
+		{
+			unsigned int length = (unsigned int)name.size();
+			file.write((const char*)&length, sizeof(length));
+			file.write(name.data(), length);
+		}
+
+		file.write((const char*)&nr_days, sizeof(nr_days));
+		file.write((const char*)days.data(), days.size() * sizeof(DailyRecord));
+
+		return file.good();
+	}
+}
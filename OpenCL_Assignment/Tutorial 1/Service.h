@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+#include "Aggregate.h"
+#include "RangeIndex.h"
+#include "ResultCache.h"
+#include "TemperatureData.h"
+#include "ZoneMap.h"
+
+using namespace std;
+
+/* Long-running query mode:
+
+	The context, queue and program are built once and the temperature, station and date columns are uploaded once.
+	Each line read afterwards is a query answered from the resident columns by filter_moments_float
+	(only over the blocks its zone map cannot answer from their summaries), or by lookups alone with a RangeIndex:
+
+		<statistic> [station NAME] [from YYYY-MM-DD] [to YYYY-MM-DD]
+
+	statistic = count | sum | mean | min | max | std | all, "quit" (or the end of the input) stops the service.
+	Every query gets exactly one "ok ..." or "error ..." line back so a client can pipeline requests.
+	With a ResultCache a repeated filter is answered without a kernel launch ("cached" ends its line)
+*/
+namespace Service {
+
+	// A parsed query line
+	struct Query {
+		string statistic;
+		int station = -1;			/// Station index, -1 = every station
+		int date_from = 0;			/// Inclusive yyyymmdd range
+		int date_to = INT_MAX;
+	};
+
+	// Columns kept on the device for the lifetime of the service
+	struct Resident {
+		cl::CommandQueue queue;
+		cl::Kernel kernel;
+		cl::Buffer temperature, station, date, moments;
+		vector<Moments> partials;
+		vector<ZoneMap::Block> zones;	/// Empty = every query scans all rows
+		RangeIndex::Index index;
+		bool indexed = false;			/// Answer from index instead of the kernel
+		size_t rows = 0;
+		size_t local_size = 0;
+	};
+
+	// Upload the columns of records, summarise every block_rows rows (0 = no zone map) and prepare the filter kernel
+	Resident Upload(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, const TemperatureData::Records& records, size_t local_size, size_t block_rows)
+	{
+		Resident resident;
+		resident.queue = queue;
+		resident.rows = records.size();
+		resident.local_size = local_size;
+
+		// Blocks are whole Workgroups so a block range can be launched at its own global offset
+		if (block_rows) {
+			block_rows = ((block_rows + local_size - 1) / local_size) * local_size;
+			resident.zones = ZoneMap::Build(records, block_rows);
+		}
+
+		size_t rows = max((size_t)1, resident.rows);
+		size_t nr_group = (rows + local_size - 1) / local_size;
+		resident.partials.resize(nr_group);
+
+		resident.temperature = cl::Buffer(context, CL_MEM_READ_ONLY, rows * sizeof(cl_float));
+		resident.station = cl::Buffer(context, CL_MEM_READ_ONLY, rows * sizeof(cl_int));
+		resident.date = cl::Buffer(context, CL_MEM_READ_ONLY, rows * sizeof(cl_int));
+		resident.moments = cl::Buffer(context, CL_MEM_WRITE_ONLY, nr_group * sizeof(Moments));
+
+		if (resident.rows) {
+			queue.enqueueWriteBuffer(resident.temperature, CL_FALSE, 0, resident.rows * sizeof(cl_float), &records.temperature[0]);
+			queue.enqueueWriteBuffer(resident.station, CL_FALSE, 0, resident.rows * sizeof(cl_int), &records.station[0]);
+			queue.enqueueWriteBuffer(resident.date, CL_TRUE, 0, resident.rows * sizeof(cl_int), &records.date[0]);
+		}
+
+		resident.kernel = cl::Kernel(program, "filter_moments_float");
+		resident.kernel.setArg(0, resident.temperature);
+		resident.kernel.setArg(1, resident.station);
+		resident.kernel.setArg(2, resident.date);
+		resident.kernel.setArg(3, resident.moments);
+
+		for (cl_uint arg = 4; arg < 8; arg++)
+			resident.kernel.setArg(arg, cl::Local(local_size * sizeof(cl_float)));
+
+		resident.kernel.setArg(8, cl::Local(local_size * sizeof(cl_int)));
+
+		return resident;
+	}
+
+	// yyyymmdd of "YYYY-MM-DD" or "YYYYMMDD" (0 if it is not a date)
+	int ParseDate(const string& text)
+	{
+		string digits;
+
+		for (char c : text)
+			if (c != '-')
+				digits += c;
+
+		if (digits.size() != 8 || digits.find_first_not_of("0123456789") != string::npos)
+			return 0;
+
+		return atoi(digits.c_str());
+	}
+
+	// Parse one query line, error describes the first problem when it returns false
+	bool Parse(const string& line, const TemperatureData::Records& records, Query& query, string& error)
+	{
+		istringstream words(line);
+		string word;
+
+		query = Query();
+
+		if (!(words >> query.statistic)) {
+			error = "empty query";
+			return false;
+		}
+
+		static const char* statistics[] = { "count", "sum", "mean", "min", "max", "std", "all" };
+
+		if (find_if(begin(statistics), end(statistics), [&](const char* name) { return query.statistic == name; }) == end(statistics)) {
+			error = "unknown statistic " + query.statistic;
+			return false;
+		}
+
+		while (words >> word)
+		{
+			string value;
+
+			if (!(words >> value)) {
+				error = word + " needs a value";
+				return false;
+			}
+
+			if (word == "station") {
+				auto found = find(records.stationNames.begin(), records.stationNames.end(), value);
+
+				if (found == records.stationNames.end()) {
+					error = "unknown station " + value;
+					return false;
+				}
+
+				query.station = (int)(found - records.stationNames.begin());
+			}
+			else if (word == "from" || word == "to") {
+				int date = ParseDate(value);
+
+				if (!date) {
+					error = "bad date " + value;
+					return false;
+				}
+
+				(word == "from" ? query.date_from : query.date_to) = date;
+			}
+			else {
+				error = "unknown filter " + word;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Merge the filtered moments of rows [first, end) into result (first is a Workgroup multiple)
+	void Scan(Resident& resident, size_t first, size_t end, Aggregate& result, cl_ulong& kernel_time)
+	{
+		size_t nr_group = (end - first + resident.local_size - 1) / resident.local_size;
+
+		resident.kernel.setArg(12, (cl_int)end);
+
+		// get_group_id excludes the global offset, so the partials of the range start at 0
+		cl::Event profiling_event;
+		resident.queue.enqueueNDRangeKernel(resident.kernel, cl::NDRange(first), cl::NDRange(nr_group * resident.local_size), cl::NDRange(resident.local_size), NULL, &profiling_event);
+		resident.queue.enqueueReadBuffer(resident.moments, CL_TRUE, 0, nr_group * sizeof(Moments), &resident.partials[0]);
+
+		kernel_time += profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+
+		for (size_t g = 0; g < nr_group; g++)
+			result.Merge(resident.partials[g]);
+	}
+
+	// Statistics of the resident rows matching query, partials merged on the host
+	Aggregate Answer(Resident& resident, const Query& query, cl_ulong& kernel_time)
+	{
+		Aggregate result;
+		kernel_time = 0;
+
+		if (!resident.rows)
+			return result;
+
+		// Prefix sums + sparse table lookups, no kernel launch
+		if (resident.indexed)
+			return RangeIndex::Query(resident.index, query.station, query.date_from, query.date_to);
+
+		resident.kernel.setArg(9, (cl_int)query.station);
+		resident.kernel.setArg(10, (cl_int)query.date_from);
+		resident.kernel.setArg(11, (cl_int)query.date_to);
+
+		if (resident.zones.empty()) {
+			Scan(resident, 0, resident.rows, result, kernel_time);
+			return result;
+		}
+
+		// Blocks inside the filter use their summary, blocks outside are skipped, consecutive boundary blocks are scanned in one launch
+		size_t scan_first = 0, scan_end = 0;
+
+		for (const ZoneMap::Block& block : resident.zones)
+		{
+			ZoneMap::Coverage coverage = ZoneMap::Classify(block, query.station, query.date_from, query.date_to);
+
+			if (coverage == ZoneMap::INSIDE)
+				result.Merge(block.aggregate);
+
+			if (coverage != ZoneMap::PARTIAL)
+				continue;
+
+			if (scan_end != block.first) {
+				if (scan_end > scan_first)
+					Scan(resident, scan_first, scan_end, result, kernel_time);
+
+				scan_first = block.first;
+			}
+
+			scan_end = block.first + block.rows;
+		}
+
+		if (scan_end > scan_first)
+			Scan(resident, scan_first, scan_end, result, kernel_time);
+
+		return result;
+	}
+
+	// Normalised filter of a query, the ResultCache key (the statistic is not part of it, every statistic comes from one Aggregate)
+	string Predicate(const Query& query)
+	{
+		return to_string(query.station) + "|" + to_string(query.date_from) + "|" + to_string(query.date_to);
+	}
+
+	// "ok" response line of an answered query
+	string Format(const Query& query, const Aggregate& result, cl_ulong kernel_time)
+	{
+		ostringstream out;
+		out << "ok";
+
+		bool all = query.statistic == "all";
+
+		if (all || query.statistic == "count") out << " count=" << result.count;
+		if (all || query.statistic == "sum") out << " sum=" << result.sum;
+
+		// Mean, Min, Max and Std Deviation are undefined without matching rows
+		if (result.count) {
+			if (all || query.statistic == "mean") out << " mean=" << result.Mean();
+			if (all || query.statistic == "min") out << " min=" << result.min;
+			if (all || query.statistic == "max") out << " max=" << result.max;
+			if (all || query.statistic == "std") out << " std=" << result.StdDev();
+		}
+		else if (!all && query.statistic != "count" && query.statistic != "sum") {
+			out << " count=0";
+		}
+
+		out << " time=" << kernel_time << "ns";
+
+		return out.str();
+	}
+
+	// Answer query lines from in until "quit" or the end of the input (consulting cache first if given), returns the number of queries answered
+	size_t Run(Resident& resident, const TemperatureData::Records& records, istream& in, ostream& out, ResultCache::Lru* cache = NULL)
+	{
+		string line;
+		size_t answered = 0;
+
+		while (getline(in, line))
+		{
+			// Windows clients send CRLF
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+
+			if (line.empty())
+				continue;
+
+			if (line == "quit")
+				break;
+
+			Query query;
+			string error;
+
+			if (!Parse(line, records, query, error)) {
+				out << "error " << error << endl;
+				continue;
+			}
+
+			cl_ulong kernel_time = 0;
+			Aggregate result;
+			bool cached = cache && cache->Get(Predicate(query), result);
+
+			if (!cached) {
+				result = Answer(resident, query, kernel_time);
+
+				if (cache)
+					cache->Put(Predicate(query), result);
+			}
+
+			// endl flushes, so a client piping queries gets each answer immediately
+			out << Format(query, result, kernel_time) << (cached ? " cached" : "") << endl;
+			answered++;
+		}
+
+		return answered;
+	}
+}
@@ -0,0 +1,566 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC/Clang only emit AVX instructions inside functions marked for them, MSVC always accepts the intrinsics
+#if defined(__GNUC__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+using namespace std;
+
+/* Hand vectorised host loops for the temperature columns with runtime CPU dispatch:
+
+	float : Sum/Min/Max, squared distances to a centre and histogram bin indices, 8 (AVX2) or 16 (AVX-512F) lanes
+	short : tenths-of-a-degree Sum/Min/Max and squared distances, 16 (AVX2) or 32 (AVX-512BW) lanes, histogram bin indices 16 at a time
+	Float sums run in float lanes flushed into a double every block, matching the precision of the scalar loops
+*/
+namespace Simd {
+
+	enum Level { SCALAR = 0, AVX2 = 1, AVX512 = 2 };
+
+	const char* Name(Level level)
+	{
+		switch (level) {
+		case AVX512: return "AVX-512";
+		case AVX2: return "AVX2";
+		default: return "Scalar";
+		}
+	}
+
+	// Widest instruction set supported by both the CPU and the OS
+	Level Detect()
+	{
+#if defined(SIMD_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+
+		if (info[0] < 7)
+			return SCALAR;
+
+		__cpuid(info, 1);
+
+		// OS must save the YMM (and ZMM) registers on context switches
+		if (!(info[2] & (1 << 27)))
+			return SCALAR;
+
+		unsigned long long xcr0 = _xgetbv(0);
+
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6;
+		bool avx512 = (info[1] & (1 << 16)) && (info[1] & (1 << 30)) && (xcr0 & 0xE6) == 0xE6;
+
+		return avx512 ? AVX512 : (avx2 ? AVX2 : SCALAR);
+#elif defined(SIMD_X86) && defined(__GNUC__)
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+			return AVX512;
+
+		return __builtin_cpu_supports("avx2") ? AVX2 : SCALAR;
+#else
+		return SCALAR;
+#endif
+	}
+
+	// Detected once per process
+	Level Best()
+	{
+		static Level level = Detect();
+		return level;
+	}
+
+	// Elements summed in float lanes before flushing into the double total
+	const size_t FLOAT_BLOCK = 4096;
+
+
+
+	// ============== Scalar ==============
+
+	void SumMinMaxScalar(const float* v, size_t n, double& sum, float& min_value, float& max_value)
+	{
+		float block = 0.0f;
+
+		for (size_t i = 0; i < n; i++) {
+			block += v[i];
+			min_value = min(min_value, v[i]);
+			max_value = max(max_value, v[i]);
+
+			if ((i & (FLOAT_BLOCK - 1)) == FLOAT_BLOCK - 1) {
+				sum += block;
+				block = 0.0f;
+			}
+		}
+
+		sum += block;
+	}
+
+	double SquaredDiffScalar(const float* v, size_t n, float centre)
+	{
+		double total = 0.0;
+		float block = 0.0f;
+
+		for (size_t i = 0; i < n; i++) {
+			float diff = v[i] - centre;
+			block += diff * diff;
+
+			if ((i & (FLOAT_BLOCK - 1)) == FLOAT_BLOCK - 1) {
+				total += block;
+				block = 0.0f;
+			}
+		}
+
+		return total + block;
+	}
+
+	void HistogramScalar(const float* v, size_t n, float lo, float scale, int bins, cl_uint* counts)
+	{
+		for (size_t i = 0; i < n; i++) {
+			int bin = (int)((v[i] - lo) * scale);
+			counts[min(max(bin, 0), bins - 1)]++;
+		}
+	}
+
+	void SumMinMaxScalar(const short* v, size_t n, long long& sum, short& min_value, short& max_value)
+	{
+		for (size_t i = 0; i < n; i++) {
+			sum += v[i];
+			min_value = min(min_value, v[i]);
+			max_value = max(max_value, v[i]);
+		}
+	}
+
+	long long SquaredDiffScalar(const short* v, size_t n, short centre)
+	{
+		long long total = 0;
+
+		for (size_t i = 0; i < n; i++)
+			total += (long long)(v[i] - centre) * (v[i] - centre);
+
+		return total;
+	}
+
+	// Same float bin arithmetic as the float histogram, lo and scale in tenths
+	void HistogramScalar(const short* v, size_t n, float lo, float scale, int bins, cl_uint* counts)
+	{
+		for (size_t i = 0; i < n; i++) {
+			int bin = (int)(((float)v[i] - lo) * scale);
+			counts[min(max(bin, 0), bins - 1)]++;
+		}
+	}
+
+
+
+#ifdef SIMD_X86
+	// ============== AVX2 ==============
+
+	SIMD_TARGET("avx2")
+	void SumMinMaxAvx2(const float* v, size_t n, double& sum, float& min_value, float& max_value)
+	{
+		__m256 vmin = _mm256_set1_ps(min_value);
+		__m256 vmax = _mm256_set1_ps(max_value);
+		size_t i = 0;
+		size_t body = n - n % 16;
+
+		while (i < body) {
+			size_t block_end = min(body, i + FLOAT_BLOCK);
+
+			// Two independent accumulators hide the add latency
+			__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+
+			for (; i < block_end; i += 16) {
+				__m256 x0 = _mm256_loadu_ps(v + i);
+				__m256 x1 = _mm256_loadu_ps(v + i + 8);
+				sum0 = _mm256_add_ps(sum0, x0);
+				sum1 = _mm256_add_ps(sum1, x1);
+				vmin = _mm256_min_ps(vmin, _mm256_min_ps(x0, x1));
+				vmax = _mm256_max_ps(vmax, _mm256_max_ps(x0, x1));
+			}
+
+			float lanes[8];
+			_mm256_storeu_ps(lanes, _mm256_add_ps(sum0, sum1));
+
+			for (int l = 0; l < 8; l++)
+				sum += lanes[l];
+		}
+
+		float lanes_min[8], lanes_max[8];
+		_mm256_storeu_ps(lanes_min, vmin);
+		_mm256_storeu_ps(lanes_max, vmax);
+
+		for (int l = 0; l < 8; l++) {
+			min_value = min(min_value, lanes_min[l]);
+			max_value = max(max_value, lanes_max[l]);
+		}
+
+		SumMinMaxScalar(v + body, n - body, sum, min_value, max_value);
+	}
+
+	SIMD_TARGET("avx2")
+	double SquaredDiffAvx2(const float* v, size_t n, float centre)
+	{
+		__m256 vcentre = _mm256_set1_ps(centre);
+		double total = 0.0;
+		size_t i = 0;
+		size_t body = n - n % 16;
+
+		while (i < body) {
+			size_t block_end = min(body, i + FLOAT_BLOCK);
+			__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+
+			for (; i < block_end; i += 16) {
+				__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(v + i), vcentre);
+				__m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(v + i + 8), vcentre);
+				sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(d0, d0));
+				sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(d1, d1));
+			}
+
+			float lanes[8];
+			_mm256_storeu_ps(lanes, _mm256_add_ps(sum0, sum1));
+
+			for (int l = 0; l < 8; l++)
+				total += lanes[l];
+		}
+
+		return total + SquaredDiffScalar(v + body, n - body, centre);
+	}
+
+	// Bin indices are computed 8 at a time, the increments go to 4 interleaved sub-histograms to avoid store forwarding stalls
+	SIMD_TARGET("avx2")
+	void HistogramAvx2(const float* v, size_t n, float lo, float scale, int bins, cl_uint* counts)
+	{
+		vector<cl_uint> sub(4 * bins, 0);
+		__m256 vlo = _mm256_set1_ps(lo), vscale = _mm256_set1_ps(scale);
+		__m256i vzero = _mm256_setzero_si256(), vlast = _mm256_set1_epi32(bins - 1);
+		size_t body = n - n % 8;
+
+		for (size_t i = 0; i < body; i += 8) {
+			__m256i bin = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(v + i), vlo), vscale));
+			bin = _mm256_min_epi32(_mm256_max_epi32(bin, vzero), vlast);
+
+			int idx[8];
+			_mm256_storeu_si256((__m256i*)idx, bin);
+
+			for (int l = 0; l < 8; l++)
+				sub[(l & 3) * bins + idx[l]]++;
+		}
+
+		for (int b = 0; b < bins; b++)
+			counts[b] += sub[b] + sub[bins + b] + sub[2 * bins + b] + sub[3 * bins + b];
+
+		HistogramScalar(v + body, n - body, lo, scale, bins, counts);
+	}
+
+	SIMD_TARGET("avx2")
+	void SumMinMaxAvx2(const short* v, size_t n, long long& sum, short& min_value, short& max_value)
+	{
+		__m256i ones = _mm256_set1_epi16(1);
+		__m256i vmin = _mm256_set1_epi16(min_value);
+		__m256i vmax = _mm256_set1_epi16(max_value);
+		size_t i = 0;
+		size_t body = n - n % 16;
+
+		while (i < body) {
+			// madd widens pairs of shorts into int lanes, 16K iterations cannot overflow them
+			size_t block_end = min(body, i + 16 * 16384);
+			__m256i vsum = _mm256_setzero_si256();
+
+			for (; i < block_end; i += 16) {
+				__m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+				vsum = _mm256_add_epi32(vsum, _mm256_madd_epi16(x, ones));
+				vmin = _mm256_min_epi16(vmin, x);
+				vmax = _mm256_max_epi16(vmax, x);
+			}
+
+			int lanes[8];
+			_mm256_storeu_si256((__m256i*)lanes, vsum);
+
+			for (int l = 0; l < 8; l++)
+				sum += lanes[l];
+		}
+
+		short lanes_min[16], lanes_max[16];
+		_mm256_storeu_si256((__m256i*)lanes_min, vmin);
+		_mm256_storeu_si256((__m256i*)lanes_max, vmax);
+
+		for (int l = 0; l < 16; l++) {
+			min_value = min(min_value, lanes_min[l]);
+			max_value = max(max_value, lanes_max[l]);
+		}
+
+		SumMinMaxScalar(v + body, n - body, sum, min_value, max_value);
+	}
+
+	// 16 tenths per load, widened to two float vectors for the bin arithmetic of HistogramAvx2
+	SIMD_TARGET("avx2")
+	void HistogramAvx2(const short* v, size_t n, float lo, float scale, int bins, cl_uint* counts)
+	{
+		vector<cl_uint> sub(4 * bins, 0);
+		__m256 vlo = _mm256_set1_ps(lo), vscale = _mm256_set1_ps(scale);
+		__m256i vzero = _mm256_setzero_si256(), vlast = _mm256_set1_epi32(bins - 1);
+		size_t body = n - n % 16;
+
+		for (size_t i = 0; i < body; i += 16) {
+			__m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+			__m256i half[2] = { _mm256_cvtepi16_epi32(_mm256_castsi256_si128(x)), _mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1)) };
+
+			for (int h = 0; h < 2; h++) {
+				__m256i bin = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(half[h]), vlo), vscale));
+				bin = _mm256_min_epi32(_mm256_max_epi32(bin, vzero), vlast);
+
+				int idx[8];
+				_mm256_storeu_si256((__m256i*)idx, bin);
+
+				for (int l = 0; l < 8; l++)
+					sub[(l & 3) * bins + idx[l]]++;
+			}
+		}
+
+		for (int b = 0; b < bins; b++)
+			counts[b] += sub[b] + sub[bins + b] + sub[2 * bins + b] + sub[3 * bins + b];
+
+		HistogramScalar(v + body, n - body, lo, scale, bins, counts);
+	}
+
+	// Requires |v - centre| <= SHORT_DIFF_LIMIT so 128 iterations of squared pairs fit the int lanes
+	SIMD_TARGET("avx2")
+	long long SquaredDiffAvx2(const short* v, size_t n, short centre)
+	{
+		__m256i vcentre = _mm256_set1_epi16(centre);
+		long long total = 0;
+		size_t i = 0;
+		size_t body = n - n % 16;
+
+		while (i < body) {
+			size_t block_end = min(body, i + 16 * 128);
+			__m256i vsum = _mm256_setzero_si256();
+
+			for (; i < block_end; i += 16) {
+				__m256i d = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)(v + i)), vcentre);
+				vsum = _mm256_add_epi32(vsum, _mm256_madd_epi16(d, d));
+			}
+
+			int lanes[8];
+			_mm256_storeu_si256((__m256i*)lanes, vsum);
+
+			for (int l = 0; l < 8; l++)
+				total += lanes[l];
+		}
+
+		return total + SquaredDiffScalar(v + body, n - body, centre);
+	}
+
+
+
+	// ============== AVX-512 ==============
+
+	SIMD_TARGET("avx512f")
+	void SumMinMaxAvx512(const float* v, size_t n, double& sum, float& min_value, float& max_value)
+	{
+		__m512 vmin = _mm512_set1_ps(min_value);
+		__m512 vmax = _mm512_set1_ps(max_value);
+		size_t i = 0;
+		size_t body = n - n % 32;
+
+		while (i < body) {
+			size_t block_end = min(body, i + FLOAT_BLOCK);
+			__m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+
+			for (; i < block_end; i += 32) {
+				__m512 x0 = _mm512_loadu_ps(v + i);
+				__m512 x1 = _mm512_loadu_ps(v + i + 16);
+				sum0 = _mm512_add_ps(sum0, x0);
+				sum1 = _mm512_add_ps(sum1, x1);
+				vmin = _mm512_min_ps(vmin, _mm512_min_ps(x0, x1));
+				vmax = _mm512_max_ps(vmax, _mm512_max_ps(x0, x1));
+			}
+
+			sum += _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+		}
+
+		min_value = min(min_value, _mm512_reduce_min_ps(vmin));
+		max_value = max(max_value, _mm512_reduce_max_ps(vmax));
+
+		SumMinMaxScalar(v + body, n - body, sum, min_value, max_value);
+	}
+
+	SIMD_TARGET("avx512f")
+	double SquaredDiffAvx512(const float* v, size_t n, float centre)
+	{
+		__m512 vcentre = _mm512_set1_ps(centre);
+		double total = 0.0;
+		size_t i = 0;
+		size_t body = n - n % 32;
+
+		while (i < body) {
+			size_t block_end = min(body, i + FLOAT_BLOCK);
+			__m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+
+			for (; i < block_end; i += 32) {
+				__m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(v + i), vcentre);
+				__m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(v + i + 16), vcentre);
+				sum0 = _mm512_fmadd_ps(d0, d0, sum0);
+				sum1 = _mm512_fmadd_ps(d1, d1, sum1);
+			}
+
+			total += _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+		}
+
+		return total + SquaredDiffScalar(v + body, n - body, centre);
+	}
+
+	SIMD_TARGET("avx512f,avx512bw")
+	void SumMinMaxAvx512(const short* v, size_t n, long long& sum, short& min_value, short& max_value)
+	{
+		__m512i ones = _mm512_set1_epi16(1);
+		__m512i vmin = _mm512_set1_epi16(min_value);
+		__m512i vmax = _mm512_set1_epi16(max_value);
+		size_t i = 0;
+		size_t body = n - n % 32;
+
+		while (i < body) {
+			size_t block_end = min(body, i + 32 * 16384);
+			__m512i vsum = _mm512_setzero_si512();
+
+			// 32 temperatures per instruction
+			for (; i < block_end; i += 32) {
+				__m512i x = _mm512_loadu_si512((const void*)(v + i));
+				vsum = _mm512_add_epi32(vsum, _mm512_madd_epi16(x, ones));
+				vmin = _mm512_min_epi16(vmin, x);
+				vmax = _mm512_max_epi16(vmax, x);
+			}
+
+			int lanes[16];
+			_mm512_storeu_si512((void*)lanes, vsum);
+
+			for (int l = 0; l < 16; l++)
+				sum += lanes[l];
+		}
+
+		short lanes_min[32], lanes_max[32];
+		_mm512_storeu_si512((void*)lanes_min, vmin);
+		_mm512_storeu_si512((void*)lanes_max, vmax);
+
+		for (int l = 0; l < 32; l++) {
+			min_value = min(min_value, lanes_min[l]);
+			max_value = max(max_value, lanes_max[l]);
+		}
+
+		SumMinMaxScalar(v + body, n - body, sum, min_value, max_value);
+	}
+
+	SIMD_TARGET("avx512f,avx512bw")
+	long long SquaredDiffAvx512(const short* v, size_t n, short centre)
+	{
+		__m512i vcentre = _mm512_set1_epi16(centre);
+		long long total = 0;
+		size_t i = 0;
+		size_t body = n - n % 32;
+
+		while (i < body) {
+			size_t block_end = min(body, i + 32 * 128);
+			__m512i vsum = _mm512_setzero_si512();
+
+			for (; i < block_end; i += 32) {
+				__m512i d = _mm512_sub_epi16(_mm512_loadu_si512((const void*)(v + i)), vcentre);
+				vsum = _mm512_add_epi32(vsum, _mm512_madd_epi16(d, d));
+			}
+
+			int lanes[16];
+			_mm512_storeu_si512((void*)lanes, vsum);
+
+			for (int l = 0; l < 16; l++)
+				total += lanes[l];
+		}
+
+		return total + SquaredDiffScalar(v + body, n - body, centre);
+	}
+#endif
+
+
+
+	// ============== Dispatch ==============
+
+	// Largest |v - centre| the vectorised short squared distance loops accept
+	const int SHORT_DIFF_LIMIT = 2047;
+
+	// Sum, Min and Max of n floats (min_value/max_value are combined with the incoming values)
+	void SumMinMax(const float* v, size_t n, Level level, double& sum, float& min_value, float& max_value)
+	{
+#ifdef SIMD_X86
+		if (level == AVX512) { SumMinMaxAvx512(v, n, sum, min_value, max_value); return; }
+		if (level == AVX2) { SumMinMaxAvx2(v, n, sum, min_value, max_value); return; }
+#endif
+		SumMinMaxScalar(v, n, sum, min_value, max_value);
+	}
+
+	// Sum of squared distances of n floats to centre
+	double SquaredDiff(const float* v, size_t n, float centre, Level level)
+	{
+#ifdef SIMD_X86
+		if (level == AVX512) return SquaredDiffAvx512(v, n, centre);
+		if (level == AVX2) return SquaredDiffAvx2(v, n, centre);
+#endif
+		return SquaredDiffScalar(v, n, centre);
+	}
+
+	// Adds n floats to equal width bins starting at lo (bin = (v - lo) * scale, clamped to [0, bins))
+	void Histogram(const float* v, size_t n, float lo, float scale, int bins, cl_uint* counts, Level level)
+	{
+#ifdef SIMD_X86
+		// AVX-512 has no faster scatter free path, the AVX2 bin computation is used for both
+		if (level != SCALAR) { HistogramAvx2(v, n, lo, scale, bins, counts); return; }
+#endif
+		HistogramScalar(v, n, lo, scale, bins, counts);
+	}
+
+	void SumMinMax(const short* v, size_t n, Level level, long long& sum, short& min_value, short& max_value)
+	{
+#ifdef SIMD_X86
+		if (level == AVX512) { SumMinMaxAvx512(v, n, sum, min_value, max_value); return; }
+		if (level == AVX2) { SumMinMaxAvx2(v, n, sum, min_value, max_value); return; }
+#endif
+		SumMinMaxScalar(v, n, sum, min_value, max_value);
+	}
+
+	// Adds n shorts to equal width bins starting at lo (same units as v)
+	void Histogram(const short* v, size_t n, float lo, float scale, int bins, cl_uint* counts, Level level)
+	{
+#ifdef SIMD_X86
+		if (level != SCALAR) { HistogramAvx2(v, n, lo, scale, bins, counts); return; }
+#endif
+		HistogramScalar(v, n, lo, scale, bins, counts);
+	}
+
+	// Sum of squared distances of n shorts within [min_value, max_value] to centre
+	long long SquaredDiff(const short* v, size_t n, short centre, short min_value, short max_value, Level level)
+	{
+#ifdef SIMD_X86
+		// Wider spreads could overflow the int lanes, the scalar loop accumulates in 64 bits
+		if (max_value - centre <= SHORT_DIFF_LIMIT && centre - min_value <= SHORT_DIFF_LIMIT) {
+			if (level == AVX512) return SquaredDiffAvx512(v, n, centre);
+			if (level == AVX2) return SquaredDiffAvx2(v, n, centre);
+		}
+#endif
+		return SquaredDiffScalar(v, n, centre);
+	}
+}
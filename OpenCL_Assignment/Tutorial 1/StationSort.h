@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+#include "TemperatureData.h"
+#include "Utils.h"
+
+using namespace std;
+
+/* Reorder the readings by (station, yyyymmddhhmm) for locality:
+
+	Every row gets a packed 64 bit key (station index above the 38 bits of yyyymmddhhmm) and the (key, row) pairs
+	are radix sorted on the device, RADIX_BITS per pass and only over the bits the largest key uses.
+	The sorted rows then permute every column, so each station becomes a contiguous, time ordered run.
+	The order only depends on the keys, so it is kept in the program cache directory as order_<hash of the keys>.bin
+	and reused by later runs over the same readings
+*/
+namespace StationSort {
+
+	const int RADIX_BITS = 4;		/// Must match my_kernels_1.cl
+	const int RADIX = 1 << RADIX_BITS;
+	const int TILE_STEPS = 16;		/// Keys per tile = TILE_STEPS * local_size
+
+	vector<cl_ulong> Keys(const TemperatureData::Records& records)
+	{
+		vector<cl_ulong> keys(records.size());
+
+		for (size_t i = 0; i < records.size(); i++)
+			keys[i] = ((cl_ulong)records.station[i] << 38) | ((cl_ulong)records.date[i] * 10000 + records.time[i]);
+
+		return keys;
+	}
+
+	// Rows of keys in ascending key order (stable), sorted on the device
+	vector<cl_int> Order(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, const vector<cl_ulong>& keys, size_t local_size, cl_ulong& kernel_time)
+	{
+		size_t rows = keys.size();
+		vector<cl_int> order(rows);
+		kernel_time = 0;
+
+		if (!rows)
+			return order;
+
+		for (size_t i = 0; i < rows; i++)
+			order[i] = (cl_int)i;
+
+		// Digits above the largest key are zero for every key and need no pass
+		cl_ulong largest = 0;
+
+		for (cl_ulong key : keys)
+			largest = max(largest, key);
+
+		int bits = 0;
+
+		while (bits < 64 && (largest >> bits))
+			bits++;
+
+		size_t tile = TILE_STEPS * local_size;
+		size_t groups = (rows + tile - 1) / tile;
+		vector<cl_int> counts(RADIX * groups);
+
+		cl::Buffer buffer_keys[2], buffer_rows[2];
+
+		for (int i = 0; i < 2; i++) {
+			buffer_keys[i] = cl::Buffer(context, CL_MEM_READ_WRITE, rows * sizeof(cl_ulong));
+			buffer_rows[i] = cl::Buffer(context, CL_MEM_READ_WRITE, rows * sizeof(cl_int));
+		}
+
+		cl::Buffer buffer_counts(context, CL_MEM_READ_WRITE, counts.size() * sizeof(cl_int));
+
+		queue.enqueueWriteBuffer(buffer_keys[0], CL_FALSE, 0, rows * sizeof(cl_ulong), &keys[0]);
+		queue.enqueueWriteBuffer(buffer_rows[0], CL_FALSE, 0, rows * sizeof(cl_int), &order[0]);
+
+		cl::Kernel kernel_count = cl::Kernel(program, "radix_count");
+		kernel_count.setArg(1, buffer_counts);
+		kernel_count.setArg(2, cl::Local(RADIX * sizeof(cl_int)));
+		kernel_count.setArg(4, (cl_int)tile);
+		kernel_count.setArg(5, (cl_int)rows);
+
+		cl::Kernel kernel_scatter = cl::Kernel(program, "radix_scatter");
+		kernel_scatter.setArg(4, buffer_counts);
+		kernel_scatter.setArg(5, cl::Local(local_size * sizeof(cl_int)));
+		kernel_scatter.setArg(6, cl::Local(RADIX * sizeof(cl_int)));
+		kernel_scatter.setArg(8, (cl_int)tile);
+		kernel_scatter.setArg(9, (cl_int)rows);
+
+		int in = 0;
+
+		for (int shift = 0; shift < bits; shift += RADIX_BITS)
+		{
+			cl::Event profiling_count, profiling_scatter;
+
+			kernel_count.setArg(0, buffer_keys[in]);
+			kernel_count.setArg(3, (cl_int)shift);
+
+			queue.enqueueNDRangeKernel(kernel_count, cl::NullRange, cl::NDRange(groups * local_size), cl::NDRange(local_size), NULL, &profiling_count);
+			queue.enqueueReadBuffer(buffer_counts, CL_TRUE, 0, counts.size() * sizeof(cl_int), &counts[0]);
+
+			// Exclusive scan over (digit, tile) on the host, RADIX * groups entries
+			cl_int total = 0;
+
+			for (cl_int& count : counts) {
+				cl_int tile_count = count;
+				count = total;
+				total += tile_count;
+			}
+
+			queue.enqueueWriteBuffer(buffer_counts, CL_FALSE, 0, counts.size() * sizeof(cl_int), &counts[0]);
+
+			kernel_scatter.setArg(0, buffer_keys[in]);
+			kernel_scatter.setArg(1, buffer_rows[in]);
+			kernel_scatter.setArg(2, buffer_keys[1 - in]);
+			kernel_scatter.setArg(3, buffer_rows[1 - in]);
+			kernel_scatter.setArg(7, (cl_int)shift);
+
+			queue.enqueueNDRangeKernel(kernel_scatter, cl::NullRange, cl::NDRange(groups * local_size), cl::NDRange(local_size), NULL, &profiling_scatter);
+			profiling_scatter.wait();
+
+			kernel_time += profiling_count.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_count.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+			kernel_time += profiling_scatter.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_scatter.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+
+			in = 1 - in;
+		}
+
+		queue.enqueueReadBuffer(buffer_rows[in], CL_TRUE, 0, rows * sizeof(cl_int), &order[0]);
+
+		return order;
+	}
+
+	// Permute every column of records into order
+	void Apply(TemperatureData::Records& records, const vector<cl_int>& order)
+	{
+		TemperatureData::Records sorted;
+		sorted.stationNames = records.stationNames;
+		sorted.station.resize(order.size());
+		sorted.date.resize(order.size());
+		sorted.time.resize(order.size());
+		sorted.temperature.resize(order.size());
+
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			sorted.station[i] = records.station[order[i]];
+			sorted.date[i] = records.date[order[i]];
+			sorted.time[i] = records.time[order[i]];
+			sorted.temperature[i] = records.temperature[order[i]];
+		}
+
+		records = sorted;
+	}
+
+	/* Cached order layout:
+
+		"TORD" | uint64 row count | int32[row count]
+	*/
+	bool LoadOrder(const string& fileDir, size_t rows, vector<cl_int>& order)
+	{
+		ifstream file(fileDir, ios::binary);
+
+		if (!file.is_open())
+			return false;
+
+		char magic[4];
+		unsigned long long count = 0;
+
+		file.read(magic, 4);
+		file.read((char*)&count, sizeof(count));
+
+		if (!file || memcmp(magic, "TORD", 4) != 0 || count != rows)
+			return false;
+
+		order.resize(rows);
+		file.read((char*)order.data(), rows * sizeof(cl_int));
+
+		if (!file.good())
+			return false;
+
+		// A corrupt order would index past the columns (or drop rows) in Apply, it must be a permutation of [0, rows)
+		vector<bool> seen(rows, false);
+
+		for (cl_int row : order) {
+			if (row < 0 || (size_t)row >= rows || seen[row])
+				return false;
+
+			seen[row] = true;
+		}
+
+		return true;
+	}
+
+	bool SaveOrder(const string& fileDir, const vector<cl_int>& order)
+	{
+		ofstream file(fileDir, ios::binary);
+
+		if (!file.is_open())
+			return false;
+
+		unsigned long long count = order.size();
+
+		file.write("TORD", 4);
+		file.write((const char*)&count, sizeof(count));
+		file.write((const char*)order.data(), order.size() * sizeof(cl_int));
+
+		return file.good();
+	}
+
+	// Sort records by (station, time), loading/saving the order in cache_dir (empty = always sort), returns true if the order was cached
+	bool Sort(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, TemperatureData::Records& records, size_t local_size, const string& cache_dir, cl_ulong& kernel_time)
+	{
+		vector<cl_ulong> keys = Keys(records);
+		vector<cl_int> order;
+		kernel_time = 0;
+
+		char file_name[32];
+		snprintf(file_name, sizeof(file_name), "order_%016llx.bin", HashBytes(keys.data(), keys.size() * sizeof(cl_ulong)));
+		string cache_path = cache_dir + "/" + file_name;
+
+		bool cached = !cache_dir.empty() && LoadOrder(cache_path, records.size(), order);
+
+		if (!cached) {
+			order = Order(context, queue, program, keys, local_size, kernel_time);
+
+			if (!cache_dir.empty())
+				SaveOrder(cache_path, order);
+		}
+
+		Apply(records, order);
+
+		return cached;
+	}
+}
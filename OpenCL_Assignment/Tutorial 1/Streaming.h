@@ -0,0 +1,237 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+#include "Aggregate.h"
+#include "Histogram.h"
+#include "TemperatureData.h"
+
+using namespace std;
+
+namespace Streaming {
+
+	/* Out-of-core statistics over a file of any size:
+
+		The file is read chunk_rows lines at a time, each chunk is reduced on the device to per Workgroup moments
+		and the moments are merged on the host. Device memory holds one chunk + its partials whatever the input size.
+		With zero_copy the parser writes into, and the partials are read from, host mapped device buffers (no transfer copies).
+		A histogram (NULL = none) bins every chunk on the device as well
+	*/
+	bool Run(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, const string& fileDir, size_t chunk_rows, size_t local_size, bool zero_copy, Aggregate& result, size_t& chunks, cl_ulong& kernel_time, Histogram::Accumulator* histogram = NULL)
+	{
+		ifstream file(fileDir);
+
+		if (!file.is_open())
+			return false;
+
+		// Chunks are whole Workgroups
+		chunk_rows = ((chunk_rows + local_size - 1) / local_size) * local_size;
+		size_t max_groups = chunk_rows / local_size;
+
+		// Host copies (unused with zero_copy)
+		vector<cl_float> chunk(zero_copy ? 0 : chunk_rows);
+		vector<Moments> partials(zero_copy ? 0 : max_groups);
+
+		// Device Buffers (fixed size)
+		cl_mem_flags host_flags = zero_copy ? CL_MEM_ALLOC_HOST_PTR : 0;
+		cl::Buffer buffer_chunk(context, CL_MEM_READ_ONLY | host_flags, chunk_rows * sizeof(cl_float));
+		cl::Buffer buffer_moments(context, CL_MEM_WRITE_ONLY | host_flags, max_groups * sizeof(Moments));
+
+		cl::Kernel kernel_moments = cl::Kernel(program, "reduce_moments_float");
+		kernel_moments.setArg(0, buffer_chunk);
+		kernel_moments.setArg(1, buffer_moments);
+		kernel_moments.setArg(2, cl::Local(local_size * sizeof(cl_float)));
+		kernel_moments.setArg(3, cl::Local(local_size * sizeof(cl_float)));
+		kernel_moments.setArg(4, cl::Local(local_size * sizeof(cl_float)));
+		kernel_moments.setArg(5, cl::Local(local_size * sizeof(cl_float)));
+
+		result = Aggregate();
+		chunks = 0;
+		kernel_time = 0;
+
+		size_t rows;
+
+		while (true)
+		{
+			if (zero_copy) {
+				cl_float* mapped = (cl_float*)queue.enqueueMapBuffer(buffer_chunk, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, chunk_rows * sizeof(cl_float));
+				rows = TemperatureData::ReadTemperatures(file, chunk_rows, mapped);
+				queue.enqueueUnmapMemObject(buffer_chunk, mapped);
+			}
+			else {
+				rows = TemperatureData::ReadTemperatures(file, chunk_rows, &chunk[0]);
+
+				if (rows)
+					queue.enqueueWriteBuffer(buffer_chunk, CL_TRUE, 0, rows * sizeof(cl_float), &chunk[0]);
+			}
+
+			if (!rows)
+				break;
+
+			size_t nr_group = (rows + local_size - 1) / local_size;
+
+			kernel_moments.setArg(6, (cl_int)rows);
+
+			cl::Event profiling_event;
+			queue.enqueueNDRangeKernel(kernel_moments, cl::NullRange, cl::NDRange(nr_group * local_size), cl::NDRange(local_size), NULL, &profiling_event);
+
+			if (histogram)
+				histogram->Add(queue, buffer_chunk, rows);
+
+			if (zero_copy) {
+				Moments* mapped = (Moments*)queue.enqueueMapBuffer(buffer_moments, CL_TRUE, CL_MAP_READ, 0, nr_group * sizeof(Moments));
+
+				for (size_t g = 0; g < nr_group; g++)
+					result.Merge(mapped[g]);
+
+				queue.enqueueUnmapMemObject(buffer_moments, mapped);
+			}
+			else {
+				queue.enqueueReadBuffer(buffer_moments, CL_TRUE, 0, nr_group * sizeof(Moments), &partials[0]);
+
+				for (size_t g = 0; g < nr_group; g++)
+					result.Merge(partials[g]);
+			}
+
+			kernel_time += profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+
+			chunks++;
+		}
+
+		return true;
+	}
+
+	/* Pipelined variant of Run: chunk N+1 is parsed and uploaded while chunk N is reduced
+
+		Each of the `slots` slots owns a pinned (host mapped) staging buffer, a device chunk and its partials.
+		Uploads go through transfer_queue and kernels + partial reads through a second compute queue,
+		ordered with cl::Event wait lists so the host only blocks when it needs a slot back.
+		With zero_copy the kernels read the staging buffers themselves: a slot is unmapped instead of uploaded
+		and mapped again once its chunk is retired. A histogram (NULL = none) is accumulated on the compute queue
+	*/
+	bool RunPipelined(const cl::Context& context, const cl::CommandQueue& transfer_queue, const cl::Program& program, const string& fileDir, size_t chunk_rows, size_t local_size, size_t slots, bool zero_copy, Aggregate& result, size_t& chunks, cl_ulong& kernel_time, Histogram::Accumulator* histogram = NULL)
+	{
+		ifstream file(fileDir);
+
+		if (!file.is_open())
+			return false;
+
+		chunk_rows = ((chunk_rows + local_size - 1) / local_size) * local_size;
+		size_t max_groups = chunk_rows / local_size;
+		slots = max(slots, (size_t)2);
+
+		cl::CommandQueue compute_queue(context, CL_QUEUE_PROFILING_ENABLE);
+
+		// Per slot resources
+		vector<cl::Buffer> buffer_staging, buffer_chunk, buffer_moments;
+		vector<cl_float*> staging(slots);
+		vector<vector<Moments> > partials(slots, vector<Moments>(max_groups));
+		vector<cl::Kernel> kernel_moments(slots);
+		vector<cl::Event> kernel_event(slots), read_event(slots);
+		vector<size_t> slot_rows(slots, 0);		/// Rows of the chunk in flight in each slot (0 = idle)
+
+		for (size_t s = 0; s < slots; s++)
+		{
+			buffer_staging.push_back(cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, chunk_rows * sizeof(cl_float)));
+			buffer_chunk.push_back(zero_copy ? buffer_staging[s] : cl::Buffer(context, CL_MEM_READ_ONLY, chunk_rows * sizeof(cl_float)));
+			buffer_moments.push_back(cl::Buffer(context, CL_MEM_WRITE_ONLY, max_groups * sizeof(Moments)));
+
+			// Pinned host memory the parser writes straight into
+			staging[s] = (cl_float*)transfer_queue.enqueueMapBuffer(buffer_staging[s], CL_TRUE, CL_MAP_WRITE, 0, chunk_rows * sizeof(cl_float));
+
+			kernel_moments[s] = cl::Kernel(program, "reduce_moments_float");
+			kernel_moments[s].setArg(0, buffer_chunk[s]);
+			kernel_moments[s].setArg(1, buffer_moments[s]);
+			kernel_moments[s].setArg(2, cl::Local(local_size * sizeof(cl_float)));
+			kernel_moments[s].setArg(3, cl::Local(local_size * sizeof(cl_float)));
+			kernel_moments[s].setArg(4, cl::Local(local_size * sizeof(cl_float)));
+			kernel_moments[s].setArg(5, cl::Local(local_size * sizeof(cl_float)));
+		}
+
+		result = Aggregate();
+		chunks = 0;
+		kernel_time = 0;
+
+		// Merge a slot's partials once its read back has completed (chunks are merged in file order)
+		auto retire = [&](size_t s) {
+			if (!slot_rows[s])
+				return;
+
+			read_event[s].wait();
+
+			size_t nr_group = (slot_rows[s] + local_size - 1) / local_size;
+
+			for (size_t g = 0; g < nr_group; g++)
+				result.Merge(partials[s][g]);
+
+			kernel_time += kernel_event[s].getProfilingInfo<CL_PROFILING_COMMAND_END>() - kernel_event[s].getProfilingInfo<CL_PROFILING_COMMAND_START>();
+			slot_rows[s] = 0;
+
+			// The kernel has read the chunk, the parser can have the staging memory back
+			if (zero_copy)
+				staging[s] = (cl_float*)transfer_queue.enqueueMapBuffer(buffer_staging[s], CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, chunk_rows * sizeof(cl_float));
+		};
+
+		for (size_t s = 0; ; s = (s + 1) % slots)
+		{
+			// The slot's previous chunk must be finished before its staging memory is reused
+			retire(s);
+
+			// Parsing overlaps the uploads and kernels already queued for the other slots
+			size_t rows = TemperatureData::ReadTemperatures(file, chunk_rows, staging[s]);
+
+			if (!rows)
+				break;
+
+			size_t nr_group = (rows + local_size - 1) / local_size;
+
+			vector<cl::Event> upload(1);
+
+			if (zero_copy)
+				transfer_queue.enqueueUnmapMemObject(buffer_staging[s], staging[s], NULL, &upload[0]);
+			else
+				transfer_queue.enqueueWriteBuffer(buffer_chunk[s], CL_FALSE, 0, rows * sizeof(cl_float), staging[s], NULL, &upload[0]);
+
+			kernel_moments[s].setArg(6, (cl_int)rows);
+
+			vector<cl::Event> reduced(1);
+			compute_queue.enqueueNDRangeKernel(kernel_moments[s], cl::NullRange, cl::NDRange(nr_group * local_size), cl::NDRange(local_size), &upload, &reduced[0]);
+
+			// In order behind the moments (so after the upload) and ahead of the read the slot is retired on
+			if (histogram)
+				histogram->Add(compute_queue, buffer_chunk[s], rows);
+
+			compute_queue.enqueueReadBuffer(buffer_moments[s], CL_FALSE, 0, nr_group * sizeof(Moments), &partials[s][0], &reduced, &read_event[s]);
+
+			kernel_event[s] = reduced[0];
+			slot_rows[s] = rows;
+
+			transfer_queue.flush();
+			compute_queue.flush();
+
+			chunks++;
+		}
+
+		// Drain the chunks still in flight, oldest first
+		size_t oldest = chunks % slots;
+
+		for (size_t i = 0; i < slots; i++)
+			retire((oldest + i) % slots);
+
+		for (size_t s = 0; s < slots; s++)
+			transfer_queue.enqueueUnmapMemObject(buffer_staging[s], staging[s]);
+
+		transfer_queue.finish();
+		compute_queue.finish();
+
+		return true;
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+#include "Aggregate.h"
+
+using namespace std;
+
+/* Mergeable result of a run, for datasets sharded across processes or machines:
+
+	Every shard saves its (count, sum, M2, min, max) and optional histogram as a small binary blob,
+	the blobs merge into exactly the statistics of the whole dataset (Chan merge of the moments, bin by bin sum of the histograms).
+	Histograms only merge when the bins are identical (otherwise the merged blob keeps the moments and drops the histogram),
+	so blob histograms use the fixed range [HIST_LO, HIST_HI] rather than each shard's own Min/Max
+*/
+namespace Summary {
+
+	const float HIST_LO = -50.0f;
+	const float HIST_HI = 50.0f;
+
+	struct Blob {
+		Aggregate aggregate;
+		float lo = HIST_LO;
+		float hi = HIST_HI;
+		vector<cl_uint> histogram;		/// Empty = no histogram
+	};
+
+	/* Binary blob layout (host byte order):
+
+		"TAGG" | int64 count | double sum | double m2 | float min | float max | float lo | float hi | uint32 bins | uint32[bins]
+	*/
+	bool Save(const string& fileDir, const Blob& blob)
+	{
+		ofstream file(fileDir, ios::binary);
+
+		if (!file.is_open())
+			return false;
+
+		unsigned int bins = (unsigned int)blob.histogram.size();
+
+		file.write("TAGG", 4);
+		file.write((const char*)&blob.aggregate.count, sizeof(blob.aggregate.count));
+		file.write((const char*)&blob.aggregate.sum, sizeof(blob.aggregate.sum));
+		file.write((const char*)&blob.aggregate.m2, sizeof(blob.aggregate.m2));
+		file.write((const char*)&blob.aggregate.min, sizeof(blob.aggregate.min));
+		file.write((const char*)&blob.aggregate.max, sizeof(blob.aggregate.max));
+		file.write((const char*)&blob.lo, sizeof(blob.lo));
+		file.write((const char*)&blob.hi, sizeof(blob.hi));
+		file.write((const char*)&bins, sizeof(bins));
+		file.write((const char*)blob.histogram.data(), bins * sizeof(cl_uint));
+
+		return file.good();
+	}
+
+	// Read a blob written by Save (false if the file is missing, truncated or not a blob)
+	bool Load(const string& fileDir, Blob& blob)
+	{
+		ifstream file(fileDir, ios::binary);
+
+		if (!file.is_open())
+			return false;
+
+		char magic[4];
+		unsigned int bins = 0;
+
+		file.read(magic, 4);
+		file.read((char*)&blob.aggregate.count, sizeof(blob.aggregate.count));
+		file.read((char*)&blob.aggregate.sum, sizeof(blob.aggregate.sum));
+		file.read((char*)&blob.aggregate.m2, sizeof(blob.aggregate.m2));
+		file.read((char*)&blob.aggregate.min, sizeof(blob.aggregate.min));
+		file.read((char*)&blob.aggregate.max, sizeof(blob.aggregate.max));
+		file.read((char*)&blob.lo, sizeof(blob.lo));
+		file.read((char*)&blob.hi, sizeof(blob.hi));
+		file.read((char*)&bins, sizeof(bins));
+
+		if (!file || memcmp(magic, "TAGG", 4) != 0)
+			return false;
+
+		blob.histogram.resize(bins);
+		file.read((char*)blob.histogram.data(), bins * sizeof(cl_uint));
+
+		return file.good();
+	}
+
+	// Fold other into blob, the moments always merge
+	// Returns false when the histograms have different bins, blob then has no histogram (it could not describe every shard)
+	bool Merge(Blob& blob, const Blob& other)
+	{
+		// An empty shard carries no histogram information either way
+		if (!other.aggregate.count)
+			return true;
+
+		if (!blob.aggregate.count) {
+			blob = other;
+			return true;
+		}
+
+		blob.aggregate.Merge(other.aggregate);
+
+		if (blob.histogram.size() != other.histogram.size() || blob.lo != other.lo || blob.hi != other.hi) {
+			blob.histogram.clear();
+			return false;
+		}
+
+		for (size_t b = 0; b < blob.histogram.size(); b++)
+			blob.histogram[b] += other.histogram[b];
+
+		return true;
+	}
+}
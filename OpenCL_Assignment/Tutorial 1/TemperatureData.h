@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+namespace TemperatureData {
+
+	// Column-per-field view of a temperature file ("STATION YYYY MM DD HHMM TEMP" per line)
+	struct Records {
+		vector<string> stationNames;	/// Station index -> Station name
+		vector<int> station;			/// Station index of each reading
+		vector<int> date;				/// yyyymmdd of each reading
+		vector<int> time;				/// hhmm of each reading
+		vector<float> temperature;		/// Temperature of each reading
+
+		size_t size() const { return temperature.size(); }
+	};
+
+	// Read a whitespace separated temperature file into Records (false if the file could not be opened)
+	bool LoadText(const string& fileDir, Records& records)
+	{
+		ifstream file(fileDir);
+
+		if (!file.is_open())
+			return false;
+
+		unordered_map<string, int> stationIndex;
+		string name;
+		int year, month, day, hhmm;
+		float temp;
+
+		while (file >> name >> year >> month >> day >> hhmm >> temp)
+		{
+			auto found = stationIndex.find(name);
+
+			if (found == stationIndex.end())
+			{
+				found = stationIndex.emplace(name, (int)records.stationNames.size()).first;
+				records.stationNames.push_back(name);
+			}
+
+			records.station.push_back(found->second);
+			records.date.push_back(year * 10000 + month * 100 + day);
+			records.time.push_back(hhmm);
+			records.temperature.push_back(temp);
+		}
+
+		return true;
+	}
+
+	// Read the temperature column of at most max_rows further lines of file into out, returns the rows read
+	size_t ReadTemperatures(istream& file, size_t max_rows, float* out)
+	{
+		string name, year, month, day, hhmm;
+		size_t rows = 0;
+
+		while (rows < max_rows && file >> name >> year >> month >> day >> hhmm >> out[rows])
+			rows++;
+
+		return rows;
+	}
+
+	// Compact int16 copy of a temperature column in tenths of a degree (the file holds one decimal)
+	vector<short> Tenths(const vector<float>& temperature)
+	{
+		vector<short> tenths(temperature.size());
+
+		for (size_t i = 0; i < temperature.size(); i++)
+			tenths[i] = (short)lround(temperature[i] * 10.0f);
+
+		return tenths;
+	}
+
+	// Readable "STATION YYYY-MM-DD HH:MM" description of a reading
+	string Describe(const Records& records, size_t row)
+	{
+		char when[32];
+		int date = records.date[row];
+
+		snprintf(when, sizeof(when), " %04d-%02d-%02d %02d:%02d", date / 10000, (date / 100) % 100, date % 100, records.time[row] / 100, records.time[row] % 100);
+
+		return records.stationNames[records.station[row]] + when;
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+using namespace std;
+
+namespace TopK {
+
+	// An extreme reading and the row it came from
+	struct Entry {
+		cl_float value;
+		cl_int row;
+	};
+
+	/* Find the K largest (or smallest) values without sorting the whole input:
+
+		Each pass sorts Workgroup sized tiles in local memory and keeps K candidates per tile,
+		shrinking the candidate list by local_size / K until a single tile's K remain
+	*/
+	void Find(const cl::Context& context, const cl::CommandQueue& queue, const cl::Program& program, const vector<cl_float>& values, size_t K, bool largest, vector<Entry>& result, cl_ulong& kernel_time)
+	{
+		size_t input_elements = values.size();
+		K = min(K, input_elements);
+		kernel_time = 0;
+		result.clear();
+
+		if (!K)
+			return;
+
+		cl::Kernel kernel_top = cl::Kernel(program, "top_k_float");
+		cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+
+		// Smallest power of 2 tile holding at least 2*K values
+		size_t local_size = 64;
+
+		while (local_size < 2 * K)
+			local_size *= 2;
+
+		if (local_size > kernel_top.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device))
+			throw cl::Error(CL_INVALID_WORK_GROUP_SIZE, "TopK: K too large for the device Workgroup size");
+
+		size_t nr_group = (input_elements + local_size - 1) / local_size;
+
+		// Device Buffers: input + ping-pong candidate lists sized for the first pass
+		cl::Buffer buffer_values(context, CL_MEM_READ_ONLY, input_elements * sizeof(cl_float));
+		cl::Buffer buffer_val[2] = { cl::Buffer(context, CL_MEM_READ_WRITE, nr_group * K * sizeof(cl_float)), cl::Buffer(context, CL_MEM_READ_WRITE, nr_group * K * sizeof(cl_float)) };
+		cl::Buffer buffer_idx[2] = { cl::Buffer(context, CL_MEM_READ_WRITE, nr_group * K * sizeof(cl_int)), cl::Buffer(context, CL_MEM_READ_WRITE, nr_group * K * sizeof(cl_int)) };
+
+		queue.enqueueWriteBuffer(buffer_values, CL_TRUE, 0, input_elements * sizeof(cl_float), &values[0]);
+
+		kernel_top.setArg(4, cl::Local(local_size * sizeof(cl_float)));
+		kernel_top.setArg(5, cl::Local(local_size * sizeof(cl_int)));
+		kernel_top.setArg(6, (cl_int)K);
+		kernel_top.setArg(7, (cl_int)largest);
+
+		size_t elements = input_elements;
+		int out = 0;
+		bool first = true;
+
+		// Each pass leaves K candidates per Workgroup until a single Workgroup remains
+		do {
+			nr_group = (elements + local_size - 1) / local_size;
+
+			kernel_top.setArg(0, first ? buffer_values : buffer_val[1 - out]);
+			kernel_top.setArg(1, first ? buffer_idx[1] : buffer_idx[1 - out]);
+			kernel_top.setArg(2, buffer_val[out]);
+			kernel_top.setArg(3, buffer_idx[out]);
+			kernel_top.setArg(8, (cl_int)first);
+			kernel_top.setArg(9, (cl_int)elements);
+
+			cl::Event profiling_event;
+			queue.enqueueNDRangeKernel(kernel_top, cl::NullRange, cl::NDRange(nr_group * local_size), cl::NDRange(local_size), NULL, &profiling_event);
+			profiling_event.wait();
+			kernel_time += profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+
+			elements = nr_group * K;
+			out = 1 - out;
+			first = false;
+		} while (nr_group > 1);
+
+		// Last pass output is already ordered from most to least extreme
+		vector<cl_float> top_values(K);
+		vector<cl_int> top_rows(K);
+
+		queue.enqueueReadBuffer(buffer_val[1 - out], CL_TRUE, 0, K * sizeof(cl_float), &top_values[0]);
+		queue.enqueueReadBuffer(buffer_idx[1 - out], CL_TRUE, 0, K * sizeof(cl_int), &top_rows[0]);
+
+		for (size_t i = 0; i < K; i++)
+			result.push_back({ top_values[i], top_rows[i] });
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+#ifdef __APPLE__
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+using namespace std;
+
+/* Host memory the device uses in place:
+
+	On CPU runtimes (and integrated GPUs) a CL_MEM_USE_HOST_PTR buffer over page aligned memory, padded to whole cache lines,
+	is used directly by the kernels, so the host vector the parser filled is never copied into a device allocation.
+	Vectors meant for Wrap take the aligned Allocator below
+*/
+namespace ZeroCopy {
+
+	const size_t ALIGNMENT = 4096;		/// Page, what the Intel/AMD CPU runtimes need to skip the copy
+	const size_t GRANULE = 64;			/// Buffer sizes are whole cache lines
+
+	// Bytes rounded up to whole GRANULEs
+	inline size_t Padded(size_t bytes)
+	{
+		return ((bytes + GRANULE - 1) / GRANULE) * GRANULE;
+	}
+
+	// Page aligned vector storage, every allocation padded to whole cache lines so Wrap can cover them
+	template <typename T>
+	struct Allocator {
+		typedef T value_type;
+
+		Allocator() {}
+		template <typename U> Allocator(const Allocator<U>&) {}
+
+		T* allocate(size_t n)
+		{
+			size_t bytes = Padded(max(n, (size_t)1) * sizeof(T));
+#ifdef _MSC_VER
+			void* p = _aligned_malloc(bytes, ALIGNMENT);
+#else
+			void* p = NULL;
+			if (posix_memalign(&p, ALIGNMENT, bytes))
+				p = NULL;
+#endif
+			if (!p)
+				throw bad_alloc();
+
+			return (T*)p;
+		}
+
+		void deallocate(T* p, size_t)
+		{
+#ifdef _MSC_VER
+			_aligned_free(p);
+#else
+			free(p);
+#endif
+		}
+	};
+
+	template <typename T, typename U> bool operator==(const Allocator<T>&, const Allocator<U>&) { return true; }
+	template <typename T, typename U> bool operator!=(const Allocator<T>&, const Allocator<U>&) { return false; }
+
+	// True when the device shares physical memory with the host (mapping is then free)
+	bool Unified(const cl::Context& context)
+	{
+		return context.getInfo<CL_CONTEXT_DEVICES>()[0].getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>() != CL_FALSE;
+	}
+
+	// Device Buffer over values' own storage (no copy on unified memory), values must outlive it and keep its size
+	template <typename T>
+	cl::Buffer Wrap(const cl::Context& context, vector<T, Allocator<T> >& values)
+	{
+		return cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, Padded(values.size() * sizeof(T)), values.data());
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#include "Aggregate.h"
+#include "TemperatureData.h"
+
+using namespace std;
+
+/* Per block summaries (zone maps) of the resident columns:
+
+	Every block of block_rows consecutive rows keeps its (count, sum, M2, min, max) and the range of its dates and stations.
+	A filter then skips the blocks it cannot match, takes the summary of the blocks it matches entirely
+	and only scans the rows of the remaining (boundary) blocks. The more the rows are ordered by date and station,
+	the fewer blocks are left to scan
+*/
+namespace ZoneMap {
+
+	struct Block {
+		size_t first = 0;			/// Rows [first, first + rows)
+		size_t rows = 0;
+		Aggregate aggregate;
+		int date_min = INT_MAX;		/// yyyymmdd range
+		int date_max = INT_MIN;
+		int station_min = INT_MAX;	/// Station index range
+		int station_max = INT_MIN;
+	};
+
+	enum Coverage { OUTSIDE, INSIDE, PARTIAL };
+
+	// Summaries of every block_rows rows of records (one host pass, done once when the columns are loaded)
+	vector<Block> Build(const TemperatureData::Records& records, size_t block_rows)
+	{
+		vector<Block> blocks;
+
+		for (size_t first = 0; first < records.size(); first += block_rows)
+		{
+			Block block;
+			block.first = first;
+			block.rows = min(block_rows, records.size() - first);
+
+			for (size_t i = first; i < first + block.rows; i++)
+			{
+				block.aggregate.Add(records.temperature[i]);
+				block.date_min = min(block.date_min, records.date[i]);
+				block.date_max = max(block.date_max, records.date[i]);
+				block.station_min = min(block.station_min, records.station[i]);
+				block.station_max = max(block.station_max, records.station[i]);
+			}
+
+			blocks.push_back(block);
+		}
+
+		return blocks;
+	}
+
+	// How the rows of block relate to a station (-1 = any) and inclusive yyyymmdd range filter
+	Coverage Classify(const Block& block, int station, int date_from, int date_to)
+	{
+		if (block.date_max < date_from || block.date_min > date_to)
+			return OUTSIDE;
+
+		if (station >= 0 && (station < block.station_min || station > block.station_max))
+			return OUTSIDE;
+
+		bool dates_inside = block.date_min >= date_from && block.date_max <= date_to;
+		bool stations_inside = station < 0 || (block.station_min == station && block.station_max == station);
+
+		return dates_inside && stations_inside ? INSIDE : PARTIAL;
+	}
+}
@@ -1,124 +1,596 @@
-// Reduce Sum of all Vector Elements from vector A to B using a local memory Vector scratch
-kernel void reduce_sum_float(global const float* A, global float* B, local float* scratch)
+// Float atomics built on atomic_cmpxchg of the value's bit pattern (OpenCL 1.2 only provides integer atomics)
+void atomic_add_float(volatile global float* p, float value)
 {
-	int id = get_global_id(0);			// Global Element Workgroup ID
-	int local_id = get_local_id(0);		// Local Element Workgroup ID
-	int N = get_local_size(0);			// Size of Local Workgroup
-	int g_id = get_group_id(0);			// Workgroup ID
+	union { unsigned int u; float f; } old_val, new_val;
 
-	// Part 1: Store into local memory
-	scratch[local_id] = A[id];
+	do {
+		old_val.f = *p;
+		new_val.f = old_val.f + value;
+	} while (atomic_cmpxchg((volatile global unsigned int*)p, old_val.u, new_val.u) != old_val.u);
+}
+
+void atomic_min_float(volatile global float* p, float value)
+{
+	union { unsigned int u; float f; } old_val, new_val;
+
+	do {
+		old_val.f = *p;
+
+		// Nothing to do once the stored value is already smaller
+		if (old_val.f <= value)
+			return;
+
+		new_val.f = value;
+	} while (atomic_cmpxchg((volatile global unsigned int*)p, old_val.u, new_val.u) != old_val.u);
+}
+
+void atomic_max_float(volatile global float* p, float value)
+{
+	union { unsigned int u; float f; } old_val, new_val;
+
+	do {
+		old_val.f = *p;
+
+		if (old_val.f >= value)
+			return;
+
+		new_val.f = value;
+	} while (atomic_cmpxchg((volatile global unsigned int*)p, old_val.u, new_val.u) != old_val.u);
+}
+
+// Zero A, run on a NUMA sub-device so the first touch places the pages of a fresh buffer on its node
+kernel void touch_float(global float* A)
+{
+	A[get_global_id(0)] = 0.0f;
+}
+
+// Roll raw readings in A up into one record per (station, day); day[id] is the compact day index of reading id
+// tmin/tmax/tsum/count hold one entry per day and must be pre-filled with +MAX/-MAX/0/0
+kernel void rollup_daily_float(global const float* A, global const int* day, global float* tmin, global float* tmax, global float* tsum, global int* count, int N)
+{
+	int id = get_global_id(0);
+
+	// Ignore the padding work items of the last Workgroup
+	if (id >= N)
+		return;
+
+	int d = day[id];
+	float value = A[id];
+
+	atomic_min_float(&tmin[d], value);
+	atomic_max_float(&tmax[d], value);
+	atomic_add_float(&tsum[d], value);
+	atomic_inc(&count[d]);
+}
+
+// Local memory flavour of atomic_add_float for per-Workgroup private accumulators
+void atomic_add_local_float(volatile local float* p, float value)
+{
+	union { unsigned int u; float f; } old_val, new_val;
+
+	do {
+		old_val.f = *p;
+		new_val.f = old_val.f + value;
+	} while (atomic_cmpxchg((volatile local unsigned int*)p, old_val.u, new_val.u) != old_val.u);
+}
+
+// Sum and count the readings of each group (e.g. station x month) into gsum/gcount
+// Each Workgroup accumulates into its own local copy of the G groups before a single global flush
+kernel void group_sum_float(global const float* A, global const int* group, global float* gsum, global int* gcount, local float* l_sum, local int* l_count, int G, int N)
+{
+	int id = get_global_id(0);
+	int local_id = get_local_id(0);
+	int L = get_local_size(0);
+
+	for (int g = local_id; g < G; g += L) {
+		l_sum[g] = 0.0f;
+		l_count[g] = 0;
+	}
 
-	// Wait for Global to Local memory complete
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	for (int stride = N / 2; stride > 0; stride /= 2) 
-	{
-		if (local_id < stride)
-			scratch[local_id] += scratch[local_id + stride];
+	if (id < N) {
+		atomic_add_local_float(&l_sum[group[id]], A[id]);
+		atomic_inc(&l_count[group[id]]);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// Flush the non empty local groups
+	for (int g = local_id; g < G; g += L) {
+		if (l_count[g]) {
+			atomic_add_float(&gsum[g], l_sum[g]);
+			atomic_add(&gcount[g], l_count[g]);
+		}
+	}
+}
+
+// Sum of squared distances of each reading to its group mean into gsq (second pass of the group Std Deviation)
+kernel void group_sq_dev_float(global const float* A, global const int* group, global const float* gsum, global const int* gcount, global float* gsq, local float* l_sq, int G, int N)
+{
+	int id = get_global_id(0);
+	int local_id = get_local_id(0);
+	int L = get_local_size(0);
+
+	for (int g = local_id; g < G; g += L)
+		l_sq[g] = 0.0f;
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (id < N) {
+		int g = group[id];
+		float diff = A[id] - gsum[g] / gcount[g];
+		atomic_add_local_float(&l_sq[g], diff * diff);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int g = local_id; g < G; g += L) {
+		if (l_sq[g] != 0.0f)
+			atomic_add_float(&gsq[g], l_sq[g]);
+	}
+}
+
+// group_sum_float without the local copies, for more groups than fit local memory (every reading is a global atomic)
+kernel void group_sum_global_float(global const float* A, global const int* group, global float* gsum, global int* gcount, int N)
+{
+	int id = get_global_id(0);
+
+	if (id >= N)
+		return;
+
+	atomic_add_float(&gsum[group[id]], A[id]);
+	atomic_inc(&gcount[group[id]]);
+}
+
+// group_sq_dev_float without the local copies
+kernel void group_sq_dev_global_float(global const float* A, global const int* group, global const float* gsum, global const int* gcount, global float* gsq, int N)
+{
+	int id = get_global_id(0);
+
+	if (id >= N)
+		return;
+
+	int g = group[id];
+	float diff = A[id] - gsum[g] / gcount[g];
+	atomic_add_float(&gsq[g], diff * diff);
+}
+
+// Compact the indices of readings whose |z-score| against their group exceeds threshold into out_idx
+// out_count receives the total number of anomalies, only the first capacity indices are stored
+kernel void flag_anomalies_float(global const float* A, global const int* group, global const float* gsum, global const int* gcount, global const float* gsq, float threshold, global int* out_idx, global int* out_count, int capacity, int N)
+{
+	int id = get_global_id(0);
+	int local_id = get_local_id(0);
+
+	local int l_count;		// Anomalies found by this Workgroup
+	local int l_base;		// First output slot reserved for this Workgroup
+
+	if (!local_id)
+		l_count = 0;
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	int slot = -1;
+
+	if (id < N) {
+		int g = group[id];
+		float mean = gsum[g] / gcount[g];
+		float std_dev = sqrt(gsq[g] / gcount[g]);
+
+		if (std_dev > 0.0f && fabs(A[id] - mean) > threshold * std_dev)
+			slot = atomic_inc(&l_count);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// One global atomic per Workgroup reserves space for all its anomalies
+	if (!local_id)
+		l_base = atomic_add(out_count, l_count);
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (slot >= 0 && l_base + slot < capacity)
+		out_idx[l_base + slot] = id;
+}
+
+// Keep the K largest (or smallest) values of each Workgroup's tile together with their row indices
+// A bitonic sort of the tile in local memory leaves the K most extreme values in the first K slots
+// Idx = row index of each A element (ignored on the first pass when identity != 0, rows are then the global ids)
+// Local size must be a power of 2 and at least 2*K so every pass shrinks the candidate list
+kernel void top_k_float(global const float* A, global const int* Idx, global float* B, global int* B_idx, local float* l_val, local int* l_idx, int K, int largest, int identity, int N)
+{
+	int id = get_global_id(0);
+	int local_id = get_local_id(0);
+	int L = get_local_size(0);
+	int g_id = get_group_id(0);
+
+	// Padding sorts to the end of the tile
+	if (id < N) {
+		l_val[local_id] = A[id];
+		l_idx[local_id] = identity ? id : Idx[id];
+	}
+	else {
+		l_val[local_id] = largest ? -INFINITY : INFINITY;
+		l_idx[local_id] = -1;
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// Bitonic sort, descending for largest and ascending for smallest
+	for (int size = 2; size <= L; size <<= 1) {
+		for (int stride = size / 2; stride > 0; stride >>= 1) {
+			int partner = local_id ^ stride;
+
+			if (partner > local_id) {
+				bool ascending = ((local_id & size) == 0) != (largest != 0);
+				float a = l_val[local_id];
+				float b = l_val[partner];
+
+				if ((a > b) == ascending) {
+					int a_idx = l_idx[local_id];
+					l_val[local_id] = b;
+					l_val[partner] = a;
+					l_idx[local_id] = l_idx[partner];
+					l_idx[partner] = a_idx;
+				}
+			}
+
+			barrier(CLK_LOCAL_MEM_FENCE);
+		}
+	}
+
+	// K best candidates of this Workgroup
+	if (local_id < K) {
+		B[g_id * K + local_id] = l_val[local_id];
+		B_idx[g_id * K + local_id] = l_idx[local_id];
+	}
+}
+
+// Reduce Min value of A and the row it came from into one (value, row) pair per Workgroup in B/B_idx
+// Idx = row of each A element (ignored on the first pass when identity != 0, rows are then the global ids)
+kernel void reduce_min_index_float(global const float* A, global const int* Idx, global float* B, global int* B_idx, local float* scratch, local int* scratch_idx, int identity, int N)
+{
+	int id = get_global_id(0);
+	int local_id = get_local_id(0);
+	int L = get_local_size(0);
+	int g_id = get_group_id(0);
+
+	// Part 1: Store into local memory, padding can never win
+	if (id < N) {
+		scratch[local_id] = A[id];
+		scratch_idx[local_id] = identity ? id : Idx[id];
+	}
+	else {
+		scratch[local_id] = INFINITY;
+		scratch_idx[local_id] = INT_MAX;
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// Part 2: Keep the smaller value, the earliest row wins ties so results do not depend on the Workgroup size
+	for (int stride = L / 2; stride > 0; stride /= 2) {
+
+		if (local_id < stride) {
+			float other = scratch[local_id + stride];
+			int other_idx = scratch_idx[local_id + stride];
+
+			if (other < scratch[local_id] || (other == scratch[local_id] && other_idx < scratch_idx[local_id])) {
+				scratch[local_id] = other;
+				scratch_idx[local_id] = other_idx;
+			}
+		}
 
 		barrier(CLK_LOCAL_MEM_FENCE);
+	}
 
+	// Part 3: Workgroup result
+	if (!local_id) {
+		B[g_id] = scratch[0];
+		B_idx[g_id] = scratch_idx[0];
+	}
+}
+
+// Reduce Max value of A and the row it came from into one (value, row) pair per Workgroup in B/B_idx
+kernel void reduce_max_index_float(global const float* A, global const int* Idx, global float* B, global int* B_idx, local float* scratch, local int* scratch_idx, int identity, int N)
+{
+	int id = get_global_id(0);
+	int local_id = get_local_id(0);
+	int L = get_local_size(0);
+	int g_id = get_group_id(0);
+
+	if (id < N) {
+		scratch[local_id] = A[id];
+		scratch_idx[local_id] = identity ? id : Idx[id];
+	}
+	else {
+		scratch[local_id] = -INFINITY;
+		scratch_idx[local_id] = INT_MAX;
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int stride = L / 2; stride > 0; stride /= 2) {
+
+		if (local_id < stride) {
+			float other = scratch[local_id + stride];
+			int other_idx = scratch_idx[local_id + stride];
+
+			if (other > scratch[local_id] || (other == scratch[local_id] && other_idx < scratch_idx[local_id])) {
+				scratch[local_id] = other;
+				scratch_idx[local_id] = other_idx;
+			}
+		}
+
+		barrier(CLK_LOCAL_MEM_FENCE);
 	}
 
-	// Part 3: Calculate total for each Workgroup
 	if (!local_id) {
-		B[g_id] = scratch[local_id];
+		B[g_id] = scratch[0];
+		B_idx[g_id] = scratch_idx[0];
 	}
 }
 
-kernel void reduce_min_float(global const float* A, global float* B, local float* scratch)
+// Per Workgroup partial statistics, merged on the host (layout matches the host Moments struct)
+typedef struct {
+	int count;
+	float sum;
+	float m2;		// Sum of squared distances to the Workgroup Mean
+	float min;
+	float max;
+} moments;
+
+// Reduce Count, Sum, Min, Max and the squared distances to the Workgroup Mean of A into one moments entry per Workgroup
+// The host merges the partials, so every statistic of a chunk needs a single pass over global memory
+kernel void reduce_moments_float(global const float* A, global moments* B, local float* l_sum, local float* l_m2, local float* l_min, local float* l_max, int N)
 {
-	int id = get_global_id(0);			// Global Element Workgroup ID
-	int local_id = get_local_id(0);		// Local Element Workgroup ID
-	int N = get_local_size(0);			// Size of Local Workgroup
+	int id = get_global_id(0);
+	int local_id = get_local_id(0);
+	int L = get_local_size(0);
 	int g_id = get_group_id(0);
 
+	// Elements of this Workgroup that are real input rather than padding
+	int count = min(L, N - g_id * L);
+	bool valid = id < N;
+	float value = valid ? A[id] : 0.0f;
+
 	// Part 1: Store into local memory
-	scratch[local_id] = A[id];
+	l_sum[local_id] = value;
+	l_min[local_id] = valid ? value : INFINITY;
+	l_max[local_id] = valid ? value : -INFINITY;
 
-	// Wait for Global to Local memory complete
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	for (int stride = N / 2; stride > 0; stride /= 2) {
+	// Part 2: Sum, Min and Max in one tree
+	for (int stride = L / 2; stride > 0; stride /= 2) {
 
-		if (local_id < stride)
-			if (scratch[local_id + stride] < scratch[local_id])
-				scratch[local_id] = scratch[local_id + stride];
+		if (local_id < stride) {
+			l_sum[local_id] += l_sum[local_id + stride];
+			l_min[local_id] = fmin(l_min[local_id], l_min[local_id + stride]);
+			l_max[local_id] = fmax(l_max[local_id], l_max[local_id + stride]);
+		}
 
 		barrier(CLK_LOCAL_MEM_FENCE);
 	}
 
-	// Part 3: Add each Thread result together via Atomic_Add into Output Vector
-	if (!local_id) {
+	// Part 3: Squared distances to the Workgroup Mean (values are still in registers)
+	float mean = l_sum[0] / count;
+	l_m2[local_id] = valid ? (value - mean) * (value - mean) : 0.0f;
 
-		B[g_id] = scratch[local_id];
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int stride = L / 2; stride > 0; stride /= 2) {
+
+		if (local_id < stride)
+			l_m2[local_id] += l_m2[local_id + stride];
 
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	if (!local_id) {
+		B[g_id].count = count;
+		B[g_id].sum = l_sum[0];
+		B[g_id].m2 = l_m2[0];
+		B[g_id].min = l_min[0];
+		B[g_id].max = l_max[0];
 	}
 }
 
-kernel void reduce_max_float(global const float* A, global float* B, local float* scratch)
+// Moments of the rows of A recorded by station_id (-1 = any station) between date_from and date_to (inclusive yyyymmdd)
+// Rows rejected by the filter contribute the identities, so a query only costs one pass over the resident columns
+kernel void filter_moments_float(global const float* A, global const int* station, global const int* date, global moments* B, local float* l_sum, local float* l_m2, local float* l_min, local float* l_max, local int* l_count, int station_id, int date_from, int date_to, int N)
 {
-	int id = get_global_id(0);			// Global Element Workgroup ID
-	int local_id = get_local_id(0);		// Local Element Workgroup ID
-	int N = get_local_size(0);			// Size of Local Workgroup
+	int id = get_global_id(0);
+	int local_id = get_local_id(0);
+	int L = get_local_size(0);
 	int g_id = get_group_id(0);
 
+	bool valid = id < N && (station_id < 0 || station[id] == station_id) && date[id] >= date_from && date[id] <= date_to;
+	float value = valid ? A[id] : 0.0f;
+
 	// Part 1: Store into local memory
-	scratch[local_id] = A[id];
+	l_sum[local_id] = value;
+	l_min[local_id] = valid ? value : INFINITY;
+	l_max[local_id] = valid ? value : -INFINITY;
+	l_count[local_id] = valid ? 1 : 0;
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	// Part 2: Count, Sum, Min and Max in one tree
+	for (int stride = L / 2; stride > 0; stride /= 2) {
+
+		if (local_id < stride) {
+			l_sum[local_id] += l_sum[local_id + stride];
+			l_min[local_id] = fmin(l_min[local_id], l_min[local_id + stride]);
+			l_max[local_id] = fmax(l_max[local_id], l_max[local_id + stride]);
+			l_count[local_id] += l_count[local_id + stride];
+		}
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+
+	// Part 3: Squared distances to the Mean of the matching rows
+	int count = l_count[0];
+	float mean = count ? l_sum[0] / count : 0.0f;
+	l_m2[local_id] = valid ? (value - mean) * (value - mean) : 0.0f;
 
-	// Wait for Global to Local memory complete
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	for (int stride = N / 2; stride > 0; stride /= 2) {
+	for (int stride = L / 2; stride > 0; stride /= 2) {
 
 		if (local_id < stride)
-			if (scratch[local_id + stride] > scratch[local_id])
-				scratch[local_id] = scratch[local_id + stride];
+			l_m2[local_id] += l_m2[local_id + stride];
 
 		barrier(CLK_LOCAL_MEM_FENCE);
 	}
 
-	// Part 3: Add each Thread result together via Atomic_Add into Output Vector
 	if (!local_id) {
+		B[g_id].count = count;
+		B[g_id].sum = l_sum[0];
+		B[g_id].m2 = l_m2[0];
+		B[g_id].min = l_min[0];
+		B[g_id].max = l_max[0];
+	}
+}
 
-		B[g_id] = scratch[local_id];
+// Equal width histogram of A over [lo, hi] into H (hi falls in the last bin)
+// Each Workgroup counts into local bins first so H only sees one atomic per bin per Workgroup
+kernel void hist_float(global const float* A, global int* H, local int* l_hist, float lo, float hi, int bins, int N)
+{
+	int id = get_global_id(0);
+	int local_id = get_local_id(0);
+	int L = get_local_size(0);
+
+	for (int b = local_id; b < bins; b += L)
+		l_hist[b] = 0;
 
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if (id < N) {
+		float scale = hi > lo ? bins / (hi - lo) : 0.0f;
+		int bin = (int)((A[id] - lo) * scale);
+		atomic_inc(&l_hist[clamp(bin, 0, bins - 1)]);
+	}
+
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int b = local_id; b < bins; b += L) {
+		if (l_hist[b])
+			atomic_add(&H[b], l_hist[b]);
 	}
 }
 
-kernel void std_dev_float(global const float* A, global float* B, global const float* sum, local float* scratch)
+// hist_float without the local bins, for more bins than fit local memory (every reading is a global atomic)
+kernel void hist_global_float(global const float* A, global int* H, float lo, float hi, int bins, int N)
 {
 	int id = get_global_id(0);
+
+	if (id >= N)
+		return;
+
+	float scale = hi > lo ? bins / (hi - lo) : 0.0f;
+	int bin = (int)((A[id] - lo) * scale);
+	atomic_inc(&H[clamp(bin, 0, bins - 1)]);
+}
+
+// Level `level` of a sparse table of M entries per level stored level after level in table:
+// table[level][i] = Min (or Max when largest) of the 2^level entries of level 0 starting at i, clipped at M
+kernel void sparse_level_float(global float* table, int M, int level, int largest)
+{
+	int i = get_global_id(0);
+
+	if (i >= M)
+		return;
+
+	global const float* prev = table + (level - 1) * M;
+	int half = 1 << (level - 1);
+
+	float a = prev[i];
+	float b = i + half < M ? prev[i + half] : a;
+
+	table[level * M + i] = largest ? fmax(a, b) : fmin(a, b);
+}
+
+// Radix sort of 64 bit keys, RADIX_BITS per pass (least significant digit first)
+#define RADIX_BITS 4
+#define RADIX (1 << RADIX_BITS)
+
+// Digit histogram of every tile of keys, stored digit major (counts[digit * groups + group])
+// so one exclusive scan of counts gives each tile the first output position of each digit
+kernel void radix_count(global const ulong* keys, global int* counts, local int* l_counts, int shift, int tile, int N)
+{
 	int local_id = get_local_id(0);
-	int N = get_local_size(0);
+	int L = get_local_size(0);
 	int g_id = get_group_id(0);
+	int groups = get_num_groups(0);
+
+	for (int d = local_id; d < RADIX; d += L)
+		l_counts[d] = 0;
 
-	// Calculate Mean (A = Sum Output)
-	float avg = sum[0] / get_global_size(0);
+	barrier(CLK_LOCAL_MEM_FENCE);
 
-	// Copy the square of each distance to the Mean into Local_Mem
-	scratch[local_id] = ((A[id] - avg) * (A[id] - avg));
+	int first = g_id * tile;
+	int end = min(first + tile, N);
 
+	for (int i = first + local_id; i < end; i += L)
+		atomic_inc(&l_counts[(keys[i] >> shift) & (RADIX - 1)]);
 
-	// Sync
 	barrier(CLK_LOCAL_MEM_FENCE);
 
+	for (int d = local_id; d < RADIX; d += L)
+		counts[d * groups + g_id] = l_counts[d];
+}
+
+// Stable scatter of every tile's keys (and their rows) to the scanned offsets of radix_count
+// The tile is walked L keys at a time, each key ranks itself among the equal digits before it in the step
+kernel void radix_scatter(global const ulong* keys, global const int* rows, global ulong* keys_out, global int* rows_out, global const int* offsets, local int* l_digit, local int* l_offset, int shift, int tile, int N)
+{
+	int local_id = get_local_id(0);
+	int L = get_local_size(0);
+	int g_id = get_group_id(0);
+	int groups = get_num_groups(0);
+
+	for (int d = local_id; d < RADIX; d += L)
+		l_offset[d] = offsets[d * groups + g_id];
 
-	// Reduce Addition all differences
-	for (int i = 1; i < N; i *= 2)
+	int first = g_id * tile;
+	int end = min(first + tile, N);
+
+	for (int base = first; base < end; base += L)
 	{
-		if (!(local_id % (i * 2)) && ((local_id + i) < N))
-		{
-			scratch[local_id] += scratch[local_id + i];
+		int i = base + local_id;
+		bool valid = i < end;
+		ulong key = valid ? keys[i] : 0;
+		int digit = valid ? (int)((key >> shift) & (RADIX - 1)) : -1;
+
+		l_digit[local_id] = digit;
+
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		int rank = 0;
+		bool last = valid;
+
+		for (int j = 0; j < L; j++) {
+			if (l_digit[j] == digit) {
+				if (j < local_id)
+					rank++;
+				else if (j > local_id)
+					last = false;
+			}
+		}
+
+		if (valid) {
+			int pos = l_offset[digit] + rank;
+			keys_out[pos] = key;
+			rows_out[pos] = rows[i];
 		}
 
 		barrier(CLK_LOCAL_MEM_FENCE);
-	}
 
-	// Atomically Add all Workgroup Local Additions
-	if (!local_id)
-		B[g_id] = scratch[local_id];
+		// The last key of each digit moves that digit's offset past the whole step
+		if (last)
+			l_offset[digit] += rank + 1;
 
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
 }
-
@@ -13,8 +13,13 @@
 #endif
 
 #include <stdlib.h>
+#include <climits>
+#include <cmath>
+#include <algorithm>
 
 #include "Utils.h"
+#include "../Reducer.h"
+#include "../my_kernels_reduce.cl.h"
 
 // Launch Arguments (e.g. "Tutorial1 - p")
 void print_help() {
@@ -23,6 +28,10 @@ void print_help() {
 	std::cerr << "  -p : select platform " << std::endl;
 	std::cerr << "  -d : select device" << std::endl;
 	std::cerr << "  -l : list all platforms and devices" << std::endl;
+	std::cerr << "  -wg : Workgroup size (power of two) the kernels are compiled for" << std::endl;
+	std::cerr << "  -items : number of elements each work-item reduces before the Workgroup tree" << std::endl;
+	std::cerr << "  -cache : directory of the cached program binaries (default: the per-user cache directory, created if missing)" << std::endl;
+	std::cerr << "  -nocache : always compile the kernels instead of loading cached program binaries" << std::endl;
 	std::cerr << "  -h : print this message" << std::endl;
 }
 
@@ -32,14 +41,27 @@ int main(int argc, char **argv)
 	// Part 1 - handle command line options such as device selection, verbosity, etc.
 	int platform_id = 0;
 	int device_id = 0;
+	string programCache = DefaultCacheDir();		/// Directory of cached program binaries and sort orders (empty = always compile)
+	size_t workgroupSize = 64;		/// Power of two, compiled into the kernels
+	size_t itemsPerThread = 4;		/// Elements accumulated by each work-item before the Workgroup tree
 
 	for (int i = 1; i < argc; i++) {
 		if ((strcmp(argv[i], "-p") == 0) && (i < (argc - 1))) { platform_id = atoi(argv[++i]); }
 		else if ((strcmp(argv[i], "-d") == 0) && (i < (argc - 1))) { device_id = atoi(argv[++i]); }
 		else if (strcmp(argv[i], "-l") == 0) { std::cout << ListPlatformsDevices() << std::endl; }
+		else if (strcmp(argv[i], "-nocache") == 0) { programCache = ""; }
+		else if ((strcmp(argv[i], "-cache") == 0) && (i < (argc - 1))) { programCache = argv[++i]; }
+		else if ((strcmp(argv[i], "-wg") == 0) && (i < (argc - 1))) { workgroupSize = strtoul(argv[++i], 0, 10); }
+		else if ((strcmp(argv[i], "-items") == 0) && (i < (argc - 1))) { itemsPerThread = strtoul(argv[++i], 0, 10); }
 		else if (strcmp(argv[i], "-h") == 0) { print_help(); return 0; }
 	}
 
+	// A cache directory that cannot be created only costs the compilation
+	if (!programCache.empty() && !MakeDirectories(programCache)) {
+		std::cerr << "Cache directory " << programCache << " could not be created, compiling from source" << std::endl;
+		programCache = "";
+	}
+
 	// Try loop entire Parallel Code for Errors
 	try {
 
@@ -55,40 +77,43 @@ int main(int argc, char **argv)
 		// Display the selected device
 		std::cout << "Running on " << GetPlatformName(platform_id) << ", " << GetDeviceName(platform_id, device_id) << std::endl;
 
+		// The reductions are compiled for workgroupSize, reject sizes they cannot run with
+		string workgroupError = CheckWorkgroupSize(context, workgroupSize);
+
+		if (!workgroupError.empty() || !itemsPerThread)
+		{
+			std::cerr << "ERROR: " << (workgroupError.empty() ? "-items must be at least 1" : workgroupError) << std::endl;
+
+			system("pause");
+			return 1;
+		}
+
 		// Create a queue to which we will push commands for the device
 		cl::CommandQueue queue(context, CL_QUEUE_PROFILING_ENABLE);
 
 		// 2.2 Load & build the device code
 		cl::Program::Sources sources;
 
-		// Load kernel to sources
-		AddSources(sources, "my_kernels_3.cl");
-
-		// Create program from Context + Sources
-		cl::Program program(context, sources);
+		// Load the kernel source compiled into the executable (no runtime file I/O)
+		AddEmbeddedSource(sources, my_kernels_reduce_cl);
 
-		// Build + Debug the Kernel code
-		try {
-			program.build();
-		}
-		catch (const cl::Error& err) {
-			std::cout << "Build Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
-			std::cout << "Build Options:\t" << program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
-			std::cout << "Build Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(context.getInfo<CL_CONTEXT_DEVICES>()[0]) << std::endl;
-			throw err;
-		}
+		// Create + Build (or load the cached binary of) the program from Context + Sources
+		/// Specialised for int16 input widened to long accumulators, and for the long partials of the further passes
+		cl::Program program = BuildProgram(context, sources, SpecialiseOptions<cl_short, cl_long>(workgroupSize, itemsPerThread), programCache);
+		cl::Program partials_program = BuildProgram(context, sources, SpecialiseOptions<cl_long, cl_long>(workgroupSize, itemsPerThread), programCache);
 
 #pragma endregion
 
 		// Value Types
-		typedef int myType;
+		/// Temperatures are stored in tenths of a degree as int16, the kernels widen them to long
+		typedef short myType;
 
 
 		// ==============  Read temperature file into String Vector  ==============
 
 		// Vectors for Raw and Numbered Temperatures
 		std::vector<string> temperatureInfo;	/// Holds file text
-		std::vector<myType> temperatureValues;	/// Holds all Temperature Floats
+		std::vector<myType> temperatureValues;	/// Holds all Temperatures in tenths of a degree
 
 		// File reading variables
 		ifstream file;
@@ -120,8 +145,9 @@ int main(int argc, char **argv)
 		for (int i = 5; i < temperatureInfo.size(); i += 6)
 		{
 			float temp = strtof(temperatureInfo[i].c_str(), 0);
-			temp *= 10;
-			temperatureValues.push_back(temp);
+
+			// Round rather than truncate (e.g. 8.3f * 10 = 82.99998)
+			temperatureValues.push_back((myType)lround(temp * 10));
 		}
 
 		// Used to calculate Average
@@ -131,52 +157,25 @@ int main(int argc, char **argv)
 
 		// ==============  Memory Allocation  ==============
 
-		size_t local_size = 64;												/// OpenCL device Workgroup size (Non-multiple = CL_ERRORS)
-
-		size_t padding_size = temperatureValues.size() % local_size;		/// Amount of appenable elements ('0')
-
-		/* Workgroup Size Handling (Padding):
-
-			If the Workgroup size is larger than the ammount of input elements...
-			...fill with empty elements to make up the size difference
-		*/
-		if (padding_size)
-		{
-			std::vector<myType> temperature_append(local_size - padding_size, 0);
-			temperatureValues.insert(temperatureValues.end(), temperature_append.begin(), temperature_append.end());
-		}
+		size_t local_size = workgroupSize;									/// OpenCL device Workgroup size (compiled into the kernels)
 
 		// OpenCL data values
 		size_t input_elements = temperatureValues.size();					/// number of elements
 		size_t input_size = temperatureValues.size() * sizeof(myType);		/// size in bytes
-		size_t nr_group = input_elements / local_size;						/// total number of workgroups to occur
-
-
-
-		// ==============  Host Output Vector ==============
-
-		// Returned values info
-		std::vector<myType> B_sum(input_elements);
-		std::vector<myType> B_min(input_elements);
-		std::vector<myType> B_max(input_elements);
-		std::vector<myType> B_std(input_elements);
-
-		// Resulting Vector Size
-		size_t output_size = B_sum.size() * sizeof(myType);
 
 
 
 		// ==============  Device Buffers  ==============
 
-		// Creates Buffers Input and Output Vectors
+		// Creates Buffers Input Vector (the Reducers own their partials buffers)
 		// Buffer A
 		cl::Buffer buffer_temperatures(context, CL_MEM_READ_WRITE, input_size);
 
-		// Buffer B(s)
-		cl::Buffer buffer_B_sum(context, CL_MEM_READ_WRITE, output_size);
-		cl::Buffer buffer_B_min(context, CL_MEM_READ_WRITE, output_size);
-		cl::Buffer buffer_B_max(context, CL_MEM_READ_WRITE, output_size);
-		cl::Buffer buffer_B_std(context, CL_MEM_READ_WRITE, output_size);
+		// Reducers (Workgroups cover local_size * itemsPerThread elements, the kernels skip indices past numOfElements so the input needs no padding)
+		Reducer<cl_short, Op::Sum, cl_long> reduce_sum(context, queue, program, partials_program, input_elements, local_size, itemsPerThread);
+		Reducer<cl_short, Op::Min, cl_long> reduce_min(context, queue, program, partials_program, input_elements, local_size, itemsPerThread);
+		Reducer<cl_short, Op::Max, cl_long> reduce_max(context, queue, program, partials_program, input_elements, local_size, itemsPerThread);
+		Reducer<cl_short, Op::SquaredDiff, cl_long> reduce_std(context, queue, program, partials_program, input_elements, local_size, itemsPerThread);
 
 
 
@@ -185,85 +184,44 @@ int main(int argc, char **argv)
 		// Create device input temperature vector Buffer
 		queue.enqueueWriteBuffer(buffer_temperatures, CL_TRUE, 0, input_size, &temperatureValues[0]);
 
-		// Create device output vector Buffer for each test case
-		queue.enqueueFillBuffer(buffer_B_sum, 0, 0, output_size);
-		queue.enqueueFillBuffer(buffer_B_min, 0, 0, output_size);
-		queue.enqueueFillBuffer(buffer_B_max, 0, 0, output_size);
-		queue.enqueueFillBuffer(buffer_B_std, 0, 0, output_size);
-
 
 
 		// ============== Sum INTS ==============
-		/// Returns the sum of all values in the first element of the vector
-
-		// Create Profiling Event (kernel information)
-		cl::Event profiling_event;
-
-		// Create Kernel call and set arguements
-		cl::Kernel kernel_sum = cl::Kernel(program, "reduce_sum");
-		kernel_sum.setArg(0, buffer_temperatures);							/// Input Vector Read Buffer
-		kernel_sum.setArg(1, buffer_B_sum);									/// Output Vector Write Buffer
-		kernel_sum.setArg(2, cl::Local(local_size * sizeof(myType)));		/// Local Memory size value
+		/// Widened to long, reduced on the device until a single value remains
 
-		// Queue 
-		queue.enqueueNDRangeKernel(kernel_sum, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_event);
-		queue.enqueueReadBuffer(buffer_B_sum, CL_TRUE, 0, output_size, &B_sum[0]);
+		cl_long sum_tenths = reduce_sum.Run(buffer_temperatures, input_elements);
 
 
 
 		// ============== Min Value INTS ==============
-		/// Returns Max value in input vector and stores it in the first element
 
-
-		cl::Event profiling_min;
-
-		cl::Kernel kernel_min = cl::Kernel(program, "reduce_min");
-		kernel_min.setArg(0, buffer_temperatures);
-		kernel_min.setArg(1, buffer_B_min);
-		kernel_min.setArg(2, cl::Local(local_size * sizeof(myType)));
-
-		queue.enqueueNDRangeKernel(kernel_min, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_min);
-		queue.enqueueReadBuffer(buffer_B_min, CL_TRUE, 0, output_size, &B_min[0]);
+		cl_long min_tenths = reduce_min.Run(buffer_temperatures, input_elements);
 
 
 		// ============== Max Value INTS ==============
-		/// Returns Max value in input vector and stores it in the first element
-
-		cl::Event profiling_max;
 
-		cl::Kernel kernel_max = cl::Kernel(program, "reduce_max");
-		kernel_max.setArg(0, buffer_temperatures);
-		kernel_max.setArg(1, buffer_B_max);
-		kernel_max.setArg(2, cl::Local(local_size * sizeof(myType)));
-
-		queue.enqueueNDRangeKernel(kernel_max, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_max);
-		queue.enqueueReadBuffer(buffer_B_max, CL_TRUE, 0, output_size, &B_max[0]);
+		cl_long max_tenths = reduce_max.Run(buffer_temperatures, input_elements);
 
 
 
 		// ============== STD Deviation ==============
-		/// Calculates the first steps of Standard Deviation
-
-		cl::Event profiling_std;
+		/// Squared distances to the Mean rounded to a whole tenth, corrected to the exact Mean on the host
 
-		cl::Kernel kernel_std = cl::Kernel(program, "std_dev");
-		kernel_std.setArg(0, buffer_temperatures);
-		kernel_std.setArg(1, buffer_B_std);
-		kernel_std.setArg(2, buffer_B_sum);
-		kernel_std.setArg(3, cl::Local(local_size * sizeof(myType)));
+		double mean_tenths = (double)sum_tenths / numOfElements;
+		cl_long centre = (cl_long)lround(mean_tenths);
 
-		queue.enqueueNDRangeKernel(kernel_std, cl::NullRange, cl::NDRange(input_elements), cl::NDRange(local_size), NULL, &profiling_std);
-		queue.enqueueReadBuffer(buffer_B_std, CL_TRUE, 0, output_size, &B_std[0]);
+		cl_long sq_tenths = reduce_std.Run(buffer_temperatures, input_elements, centre);
 
 
 
 		// ============== Format Results ==============
-		float sum = B_sum[0];
-		sum /= 10;
-		float avg = (sum / numOfElements);
-		float min_value = (float)B_min[0] / 10;
-		float max_value = (float)B_max[0] / 10;
-		float variance = (B_std[0] / numOfElements) / 10.0f;
+		/// Sum((x - mean)^2) = Sum((x - centre)^2) - n * (mean - centre)^2, tenths^2 / 100 = degrees^2
+		float sum = (float)(sum_tenths / 10.0);
+		float avg = (float)(mean_tenths / 10.0);
+		float min_value = (float)min_tenths / 10;
+		float max_value = (float)max_tenths / 10;
+		double m2_tenths = sq_tenths - numOfElements * (mean_tenths - centre) * (mean_tenths - centre);
+		float variance = (float)(m2_tenths / numOfElements / 100.0);
 		float std_dev = sqrt(variance);
 
 
@@ -271,8 +229,9 @@ int main(int argc, char **argv)
 
 		std::cout << "\nProgram Execution Completed!\n" << endl;
 
-		std::cout << GetFullProfilingInfo(profiling_event, ProfilingResolution::PROF_US) << endl;
-		std::cout << "Workgroup Size: " << local_size << endl << endl;
+		std::cout << GetFullProfilingInfo(reduce_sum.first_event, ProfilingResolution::PROF_US) << endl;
+		std::cout << "Workgroup Size: " << local_size << " (" << itemsPerThread << " items per thread)" << endl;
+		std::cout << "Input Size: " << input_size << " bytes (" << sizeof(myType) << " per temperature)" << endl << endl;
 
 		std::cout << "********************* INT Results *********************" << endl;
 		std::cout << "Sum		= " << sum << endl;
@@ -282,12 +241,11 @@ int main(int argc, char **argv)
 		std::cout << "Std Deviation   = " << std_dev << endl << endl;
 
 		std::cout << "********************* Profiling *********************" << endl;
-		std::cout << "AVG Time:	" << profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>() << " [ns]" << endl;
-		std::cout << "Min Time:	" << profiling_min.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_min.getProfilingInfo<CL_PROFILING_COMMAND_START>() << " [ns]" << endl;
-		std::cout << "Max Time:	" << profiling_max.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_max.getProfilingInfo<CL_PROFILING_COMMAND_START>() << " [ns]" << endl;
-		std::cout << "Std Time:	" << profiling_std.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_std.getProfilingInfo<CL_PROFILING_COMMAND_START>() << " [ns]" << endl << endl;
-
-		std::cout << "Total Program Execution Time: " << profiling_max.getProfilingInfo<CL_PROFILING_COMMAND_END>() - profiling_event.getProfilingInfo<CL_PROFILING_COMMAND_START>() << " ns \n" << endl;
+		std::cout << "AVG Time:	" << reduce_sum.kernel_time << " [ns]" << endl;
+		std::cout << "Min Time:	" << reduce_min.kernel_time << " [ns]" << endl;
+		std::cout << "Max Time:	" << reduce_max.kernel_time << " [ns]" << endl;
+		std::cout << "Std Time:	" << reduce_std.kernel_time << " [ns]" << endl;
+		std::cout << "Kernel Time:	" << reduce_sum.kernel_time + reduce_min.kernel_time + reduce_max.kernel_time + reduce_std.kernel_time << " [ns] (every pass of every statistic)" << endl << endl;
 
 	}
 	catch (cl::Error err) {
@@ -1,10 +1,20 @@
 #pragma once
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <list>
 #include <vector>
 #include <iostream>
 #include <sstream>
 
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
 #ifdef __APPLE__
 #include <OpenCL/cl.hpp>
 #else
@@ -121,10 +131,181 @@ void CheckError(cl_int error) {
 }
 
 void AddSources(cl::Program::Sources& sources, const string& file_name) {
-	//TODO: add file existence check
+	// Sources only point at the text, keep every loaded file alive (list elements never move)
+	static list<string> source_codes;
+
 	ifstream file(file_name);
-	string* source_code = new string(istreambuf_iterator<char>(file), (istreambuf_iterator<char>()));
-	sources.push_back(make_pair((*source_code).c_str(), source_code->length() + 1));
+
+	if (!file.is_open())
+		cerr << "Kernel file " << file_name << " was not found!" << endl;
+
+	source_codes.push_back(string(istreambuf_iterator<char>(file), (istreambuf_iterator<char>())));
+	sources.push_back(make_pair(source_codes.back().c_str(), source_codes.back().length() + 1));
+}
+
+// Add a kernel source compiled into the executable (a generated <kernel>.cl.h array, see EmbedKernel.ps1)
+void AddEmbeddedSource(cl::Program::Sources& sources, const char* source) {
+	sources.push_back(make_pair(source, strlen(source) + 1));
+}
+
+// 64 bit FNV-1a hash of size bytes at data (chain calls through hash)
+unsigned long long HashBytes(const void* data, size_t size, unsigned long long hash = 14695981039346656037ULL) {
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// 64 bit FNV-1a hash of text (chain calls through hash)
+unsigned long long HashString(const string& text, unsigned long long hash = 14695981039346656037ULL) {
+	return HashBytes(text.data(), text.size(), hash);
+}
+
+// Create dir and any missing parent directories, true if dir then exists
+bool MakeDirectories(const string& dir) {
+	for (size_t i = 1; i <= dir.size(); i++) {
+		if (i == dir.size() || dir[i] == '/' || dir[i] == '\\') {
+			// Existing prefixes (and drive letters) just fail
+#ifdef _WIN32
+			_mkdir(dir.substr(0, i).c_str());
+#else
+			mkdir(dir.substr(0, i).c_str(), 0755);
+#endif
+		}
+	}
+
+	struct stat info;
+
+	return !dir.empty() && stat(dir.c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+}
+
+// Per-user cache directory shared by runs from any working directory (empty when the environment names no user profile)
+/// %LOCALAPPDATA%\OpenCL_Assignment on Windows, $XDG_CACHE_HOME/opencl_assignment or ~/.cache/opencl_assignment elsewhere
+string DefaultCacheDir() {
+#ifdef _WIN32
+	const char* local_app_data = getenv("LOCALAPPDATA");
+
+	return local_app_data && *local_app_data ? string(local_app_data) + "\\OpenCL_Assignment" : "";
+#else
+	const char* xdg_cache = getenv("XDG_CACHE_HOME");
+	const char* home = getenv("HOME");
+
+	if (xdg_cache && *xdg_cache)
+		return string(xdg_cache) + "/opencl_assignment";
+
+	return home && *home ? string(home) + "/.cache/opencl_assignment" : "";
+#endif
+}
+
+/* Build sources for the context's (first) device through an on-disk binary cache:
+
+	Binaries are stored in cache_dir as kernels_<hash>.bin, hashed over the device name, driver version,
+	build options and kernel source, so any change to them misses the cache. A rejected or stale binary is rebuilt from source.
+	An empty cache_dir always builds from source
+*/
+cl::Program BuildProgram(const cl::Context& context, const cl::Program::Sources& sources, const string& options = "", const string& cache_dir = "") {
+	cl::Device device = context.getInfo<CL_CONTEXT_DEVICES>()[0];
+
+	unsigned long long hash = HashString(device.getInfo<CL_DEVICE_NAME>() + "|" + device.getInfo<CL_DRIVER_VERSION>() + "|" + options);
+
+	for (const auto& source : sources)
+		hash = HashBytes(source.first, source.second, hash);
+
+	char file_name[32];
+	snprintf(file_name, sizeof(file_name), "kernels_%016llx.bin", hash);
+	string cache_path = cache_dir + "/" + file_name;
+
+	if (!cache_dir.empty()) {
+		ifstream cached(cache_path, ios::binary);
+
+		if (cached.is_open()) {
+			vector<unsigned char> binary((istreambuf_iterator<char>(cached)), istreambuf_iterator<char>());
+
+			try {
+				cl::Program::Binaries binaries(1, make_pair((const void*)binary.data(), binary.size()));
+				cl::Program program(context, { device }, binaries);
+				program.build({ device }, options.c_str());
+				return program;
+			}
+			catch (const cl::Error&) {
+				// Fall through to a source build, which overwrites the bad binary
+			}
+		}
+	}
+
+	cl::Program program(context, sources);
+
+	try {
+		program.build({ device }, options.c_str());
+	}
+	catch (const cl::Error& err) {
+		std::cout << "Build Status: " << program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(device) << std::endl;
+		std::cout << "Build Options:\t" << program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(device) << std::endl;
+		std::cout << "Build Log:\t " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
+		throw err;
+	}
+
+	if (!cache_dir.empty()) {
+		// Single device program = single binary (queried through the C API, cl.hpp does not allocate the binary buffers)
+		size_t binary_size = 0;
+		clGetProgramInfo(program(), CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binary_size, NULL);
+
+		if (binary_size) {
+			vector<unsigned char> binary(binary_size);
+			unsigned char* binary_ptr = binary.data();
+			clGetProgramInfo(program(), CL_PROGRAM_BINARIES, sizeof(unsigned char*), &binary_ptr, NULL);
+
+			ofstream cached(cache_path, ios::binary);
+			cached.write((const char*)binary.data(), binary.size());
+		}
+	}
+
+	return program;
+}
+
+// OpenCL C name and Min/Max identities of the host types the specialised kernels are built for
+template <typename T> struct ClType;
+template <> struct ClType<cl_float> { static string Name() { return "float"; } static string Lowest() { return "-FLT_MAX"; } static string Highest() { return "FLT_MAX"; } };
+template <> struct ClType<cl_int> { static string Name() { return "int"; } static string Lowest() { return "INT_MIN"; } static string Highest() { return "INT_MAX"; } };
+template <> struct ClType<cl_long> { static string Name() { return "long"; } static string Lowest() { return "LONG_MIN"; } static string Highest() { return "LONG_MAX"; } };
+template <> struct ClType<cl_short> { static string Name() { return "short"; } static string Lowest() { return "SHRT_MIN"; } static string Highest() { return "SHRT_MAX"; } };
+
+// Build options specialising my_kernels_reduce.cl: T elements widened to Acc, wg_size work-items reducing items_per_thread elements each
+/// The macros are RED_ prefixed, the options also reach every other source built into the same program
+template <typename T, typename Acc>
+string SpecialiseOptions(size_t wg_size, size_t items_per_thread) {
+	stringstream options;
+
+	options << "-D RED_T=" << ClType<T>::Name() << " -D RED_ACC=" << ClType<Acc>::Name();
+	options << " -D RED_ACC_LOWEST=" << ClType<Acc>::Lowest() << " -D RED_ACC_HIGHEST=" << ClType<Acc>::Highest();
+	options << " -D RED_WG_SIZE=" << wg_size << " -D RED_ITEMS_PER_THREAD=" << items_per_thread;
+
+	return options.str();
+}
+
+// Why wg_size cannot be the Workgroup size of the specialised reductions on device (empty = it can)
+/// The trees need a power of two and reqd_work_group_size fails the launch above CL_DEVICE_MAX_WORK_GROUP_SIZE
+string CheckWorkgroupSize(const cl::Device& device, size_t wg_size) {
+	stringstream error;
+
+	if (!wg_size || (wg_size & (wg_size - 1)))
+		error << "Workgroup size " << wg_size << " is not a power of two";
+	else {
+		size_t max_size = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+
+		if (wg_size > max_size)
+			error << "Workgroup size " << wg_size << " exceeds the maximum of " << max_size << " of " << device.getInfo<CL_DEVICE_NAME>();
+	}
+
+	return error.str();
+}
+
+// Same check on the context's (first) device
+string CheckWorkgroupSize(const cl::Context& context, size_t wg_size) {
+	return CheckWorkgroupSize(context.getInfo<CL_CONTEXT_DEVICES>()[0], wg_size);
 }
 
 string ListPlatformsDevices() {
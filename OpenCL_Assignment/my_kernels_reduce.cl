@@ -0,0 +1,154 @@
+// Reductions specialised at build time, shared by Float.cpp and Int.cpp
+/// The host passes the configuration as build options (see SpecialiseOptions in Utils.h):
+///		-D RED_T=...				element type of the input (float, int, short)
+///		-D RED_ACC=...				accumulator type the elements are widened to (float, int)
+///		-D RED_ACC_LOWEST/HIGHEST	identities of Max/Min for RED_ACC (e.g. -FLT_MAX / FLT_MAX)
+///		-D RED_WG_SIZE=...			Workgroup size, a power of two (the kernels require it)
+///		-D RED_ITEMS_PER_THREAD=...	elements each work-item accumulates before the tree
+/// Every kernel writes one partial per Workgroup into B, N = number of real elements of A
+/// The macros carry a RED_ prefix because Float.cpp builds my_kernels_1.cl into the same program with the same options
+
+#ifndef RED_T
+#define RED_T float
+#endif
+
+#ifndef RED_ACC
+#define RED_ACC RED_T
+#endif
+
+#ifndef RED_ACC_LOWEST
+#define RED_ACC_LOWEST (-FLT_MAX)
+#endif
+
+#ifndef RED_ACC_HIGHEST
+#define RED_ACC_HIGHEST FLT_MAX
+#endif
+
+#ifndef RED_WG_SIZE
+#define RED_WG_SIZE 64
+#endif
+
+#ifndef RED_ITEMS_PER_THREAD
+#define RED_ITEMS_PER_THREAD 1
+#endif
+
+// Elements covered by one Workgroup
+#define RED_GROUP_ITEMS (RED_WG_SIZE * RED_ITEMS_PER_THREAD)
+
+RED_ACC op_sum(RED_ACC a, RED_ACC b) { return a + b; }
+RED_ACC op_min(RED_ACC a, RED_ACC b) { return min(a, b); }
+RED_ACC op_max(RED_ACC a, RED_ACC b) { return max(a, b); }
+
+/* Workgroup tree of the RED_WG_SIZE entries of scratch with OP:
+
+	Sequential addressing (stride halves each step, active work-items stay contiguous).
+	RED_WG_SIZE is a compile time constant so the loop is fully unrolled into log2(RED_WG_SIZE) steps
+*/
+#define RED_TREE_REDUCE(OP) \
+RED_ACC tree_##OP(local RED_ACC* scratch, int local_id) \
+{ \
+	barrier(CLK_LOCAL_MEM_FENCE); \
+	_Pragma("unroll") \
+	for (int stride = RED_WG_SIZE / 2; stride > 0; stride /= 2) \
+	{ \
+		if (local_id < stride) \
+			scratch[local_id] = OP(scratch[local_id], scratch[local_id + stride]); \
+\
+		barrier(CLK_LOCAL_MEM_FENCE); \
+	} \
+\
+	return scratch[0]; \
+}
+
+RED_TREE_REDUCE(op_sum)
+RED_TREE_REDUCE(op_min)
+RED_TREE_REDUCE(op_max)
+
+/* Per work-item accumulation of RED_ITEMS_PER_THREAD elements, RED_WG_SIZE apart so each step's loads are coalesced:
+
+	acc = OP(acc, EXPR(x)) for every real element x of the work-item, the padded tail keeps the identity
+*/
+#define RED_ACCUMULATE(acc, OP, EXPR) \
+{ \
+	int first = get_group_id(0) * RED_GROUP_ITEMS + get_local_id(0); \
+\
+	_Pragma("unroll") \
+	for (int k = 0; k < RED_ITEMS_PER_THREAD; k++) \
+	{ \
+		int i = first + k * RED_WG_SIZE; \
+\
+		if (i < N) \
+		{ \
+			RED_ACC x = (RED_ACC)A[i]; \
+			acc = OP(acc, EXPR); \
+		} \
+	} \
+}
+
+// Sum partials
+__attribute__((reqd_work_group_size(RED_WG_SIZE, 1, 1)))
+kernel void reduce_sum_t(global const RED_T* A, global RED_ACC* B, int N)
+{
+	local RED_ACC scratch[RED_WG_SIZE];
+	int local_id = get_local_id(0);
+
+	RED_ACC acc = 0;
+	RED_ACCUMULATE(acc, op_sum, x)
+
+	scratch[local_id] = acc;
+	acc = tree_op_sum(scratch, local_id);
+
+	if (!local_id)
+		B[get_group_id(0)] = acc;
+}
+
+// Min partials
+__attribute__((reqd_work_group_size(RED_WG_SIZE, 1, 1)))
+kernel void reduce_min_t(global const RED_T* A, global RED_ACC* B, int N)
+{
+	local RED_ACC scratch[RED_WG_SIZE];
+	int local_id = get_local_id(0);
+
+	RED_ACC acc = RED_ACC_HIGHEST;
+	RED_ACCUMULATE(acc, op_min, x)
+
+	scratch[local_id] = acc;
+	acc = tree_op_min(scratch, local_id);
+
+	if (!local_id)
+		B[get_group_id(0)] = acc;
+}
+
+// Max partials
+__attribute__((reqd_work_group_size(RED_WG_SIZE, 1, 1)))
+kernel void reduce_max_t(global const RED_T* A, global RED_ACC* B, int N)
+{
+	local RED_ACC scratch[RED_WG_SIZE];
+	int local_id = get_local_id(0);
+
+	RED_ACC acc = RED_ACC_LOWEST;
+	RED_ACCUMULATE(acc, op_max, x)
+
+	scratch[local_id] = acc;
+	acc = tree_op_max(scratch, local_id);
+
+	if (!local_id)
+		B[get_group_id(0)] = acc;
+}
+
+// Partials of the squared distances to centre (the Mean, or for integer types the rounded Mean)
+__attribute__((reqd_work_group_size(RED_WG_SIZE, 1, 1)))
+kernel void sq_dev_t(global const RED_T* A, global RED_ACC* B, RED_ACC centre, int N)
+{
+	local RED_ACC scratch[RED_WG_SIZE];
+	int local_id = get_local_id(0);
+
+	RED_ACC acc = 0;
+	RED_ACCUMULATE(acc, op_sum, (x - centre) * (x - centre))
+
+	scratch[local_id] = acc;
+	acc = tree_op_sum(scratch, local_id);
+
+	if (!local_id)
+		B[get_group_id(0)] = acc;
+}